@@ -34,7 +34,7 @@ const FileAnnotation* Annotate::lookupAnnotation(SCRef sha)
     if (!valid || sha.isEmpty())
         return NULL;
 
-    AnnotateHistory::const_iterator it = ah.constFind(toTempSha(sha));
+    AnnotateHistory::const_iterator it = ah.constFind(ObjectId(sha));
     if (it != ah.constEnd())
         return &(it.value());
 
@@ -43,7 +43,7 @@ const FileAnnotation* Annotate::lookupAnnotation(SCRef sha)
     const QString ancestorSha = getAncestor(sha, &shaIdx);
 
     if (!ancestorSha.isEmpty()) {
-        it = ah.constFind(toTempSha(ancestorSha));
+        it = ah.constFind(ObjectId(ancestorSha));
         if (it != ah.constEnd())
             return &(it.value());
     }
@@ -136,16 +136,16 @@ void Annotate::annotateFileHistory()
     } while (it != histRevOrder.constBegin() && !isError && !cancelingAnnotate);
 }
 
-void Annotate::doAnnotate(const ShaString& ss) {
+void Annotate::doAnnotate(const ObjectId& id) {
 // all the parents annotations must be valid here
 
-    const QString sha(ss);
+    const QString sha(id.toString());
     FileAnnotation* fa = getFileAnnotation(sha);
 
     if (fa == NULL || fa->isValid || isError || cancelingAnnotate)
         return;
 
-    const Revision* r = git->revLookup(ss, fh); // historyRevs
+    const Revision* r = git->revLookup(id, fh); // historyRevs
 
     if (r == NULL) {
         dbp("ASSERT doAnnotate: no revision %1", sha);
@@ -156,7 +156,7 @@ void Annotate::doAnnotate(const ShaString& ss) {
     const QString& diff(getPatch(sha)); // set FileAnnotation::fileSha
 
     if (r->parentsCount() == 0) { // initial revision
-        setInitialAnnotation(ah[ss].fileSha, fa); // calls Qt event loop
+        setInitialAnnotation(ah[id].fileSha, fa); // calls Qt event loop
         fa->isValid = true;
         return;
     }
@@ -204,7 +204,7 @@ void Annotate::doAnnotate(const ShaString& ss) {
 
 FileAnnotation* Annotate::getFileAnnotation(SCRef sha)
 {
-    AnnotateHistory::iterator it(ah.find(toTempSha(sha)));
+    AnnotateHistory::iterator it(ah.find(ObjectId(sha)));
 
     if (it == ah.end()) {
         dbp("ASSERT getFileAnnotation: no revision %1", sha);
@@ -370,28 +370,23 @@ bool Annotate::setAnnotation(SCRef diff, SCRef author, SCList prevAnn, SList new
 
 const QString Annotate::getPatch(SCRef sha, int parentNum)
 {
-    QString mergeSha(sha);
+    const ObjectId id(sha);
 
-    if (parentNum)
-        mergeSha = QString::number(parentNum) + " m " + sha;
-
-    const Revision* r = git->revLookup(mergeSha, fh);
+    // split merges are stored with parent number as variant
+    const Revision* r = git->revLookup(parentNum ? ObjectId(id, parentNum) : id, fh);
 
     if (!r)
         return QString();
 
     const QString diff(r->diff());
 
-    QVector<QByteArray> ba;
-    const ShaString& ss = toPersistentSha(sha, ba);
-
-    if (ah[ss].fileSha.isEmpty() && !parentNum) {
+    if (ah[id].fileSha.isEmpty() && !parentNum) {
         int idx = diff.indexOf("..");
 
         if (idx != -1)
-            ah[ss].fileSha = diff.mid(idx + 2, 40);
+            ah[id].fileSha = diff.mid(idx + 2, 40);
         else // file mode change only, same sha of parent
-            ah[ss].fileSha = ah[r->parent(0)].fileSha;
+            ah[id].fileSha = ah[r->parent(0)].fileSha;
     }
 
     return diff;
@@ -696,13 +691,13 @@ const QString Annotate::getAncestor(SCRef sha, int* shaIdx)
 
         const FileAnnotation& fa(ah[histRevOrder[*shaIdx]]);
         if (fa.fileSha == fileSha)
-            return histRevOrder[*shaIdx];
+            return histRevOrder[*shaIdx].toString();
     }
     // ok still not found, this could happen if sha is an unapplied
     // stgit patch. In this case fall back on the first in the list
     // that is the newest.
     if (git->m_references.containsType(QGit::toTempSha(sha), Reference::UN_APPLIED))
-        return histRevOrder.first();
+        return histRevOrder.first().toString();
 
     dbp("ASSERT in getAncestor: ancestor of %1 not found", sha);
     return "";
@@ -715,17 +710,28 @@ bool Annotate::isDescendant(SCRef sha, SCRef target)
     // a merge is found the search returns false because you'll need,
     // in general, all the previous ranges to compute the target one.
 
+    // file history is a subset of the main one, so if main history
+    // says 'sha' is not an ancestor there is no need to walk
+    bool known;
+    if (!git->isAncestor(sha, target, &known) && known)
+        return false;
+
     const Revision* r = git->revLookup(sha, fh);
     if (!r)
         return false;
 
     int shaIdx = r->orderIdx;
     r = git->revLookup(target, fh);
+    if (!r)
+        return false;
+
+    const RevGraph& g = fh->graph;
+    int idx = r->orderIdx;
 
-    while (r && r->orderIdx < shaIdx && r->parentsCount() == 1)
-        r = git->revLookup(r->parent(0), fh);
+    while (idx != -1 && idx < shaIdx && g.parentsCount(idx) == 1)
+        idx = g.parent(idx, 0);
 
-    return (r && r->orderIdx == shaIdx);
+    return (idx == shaIdx);
 }
 
 /*
@@ -752,10 +758,9 @@ const QString Annotate::computeRanges(SCRef sha, int paraFrom, int paraTo, SCRef
 
     QString ancestor(sha);
     int shaIdx;
-    QVector<QByteArray> ba;
-    const ShaString& ss = toPersistentSha(sha, ba);
+    const ObjectId id(sha);
     for (shaIdx = 0; shaIdx < histRevOrder.count(); shaIdx++)
-        if (histRevOrder[shaIdx] == ss)
+        if (histRevOrder[shaIdx] == id)
             break;
 
     if (shaIdx == histRevOrder.count()) { // not in history, find an ancestor
@@ -770,7 +775,7 @@ const QString Annotate::computeRanges(SCRef sha, int paraFrom, int paraTo, SCRef
     bool isDirectDescendant = isDescendant(ancestor, target);
 
     // going back in history, to oldest following first parent lane
-    const QString oldest(histRevOrder.last()); // causes a detach!
+    const QString oldest(histRevOrder.last().toString());
     const Revision* curRev = git->revLookup(ancestor, fh); // historyRevs
     QString curRevSha(curRev->sha());
 
@@ -818,7 +823,7 @@ const QString Annotate::computeRanges(SCRef sha, int paraFrom, int paraTo, SCRef
 
     for ( ; shaIdx >= 0; shaIdx--) {
 
-        SCRef sha(histRevOrder[shaIdx]);
+        const QString sha(histRevOrder[shaIdx].toString());
 
         if (!ranges.contains(sha)) {
 
@@ -43,7 +43,7 @@ private slots:
 
 private:
     void annotateFileHistory();
-    void doAnnotate(const ShaString &sha);
+    void doAnnotate(const ObjectId& id);
     FileAnnotation *getFileAnnotation(SCRef sha);
     void setInitialAnnotation(SCRef fileSha, FileAnnotation *fa);
     const QString setupAuthor(SCRef origAuthor, int annId);
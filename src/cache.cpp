@@ -66,20 +66,18 @@ bool Cache::save(const QString& gitDir, const RevFileMap& rf, const StrVect& dir
     QVector<const RevFile*> v;
     v.reserve(rf.count());
 
-    QVector<QByteArray> ba;
-    ShaString CUSTOM_SHA_RAW(toPersistentSha(CUSTOM_SHA, ba));
     unsigned int newSize = 0;
 
     FOREACH (RevFileMap, it, rf) {
 
-        const ShaString& sha = it.key();
-        if (   sha == ZERO_SHA_RAW
-            || sha == CUSTOM_SHA_RAW
-            || sha.latin1()[0] == 'A') // ALL_MERGE_FILES + rev sha
+        // skip working dir, custom diffs and merge files
+        // keys, they are not persistent git objects
+        const ObjectId& id = it.key();
+        if (id == ZERO_SHA_ID || id.variant() != ObjectId::PLAIN_ID)
             continue;
 
         v.append(it.value());
-        buf.append(sha.latin1()).append('\0');
+        buf.append(id.toString().toLatin1()).append('\0');
         newSize += 41;
         if (newSize > bufSize) {
             dbs("ASSERT in Cache::save, out of allocated space");
@@ -110,8 +108,7 @@ bool Cache::save(const QString& gitDir, const RevFileMap& rf, const StrVect& dir
     return true;
 }
 
-bool Cache::load(const QString& gitDir, RevFileMap& rfm, StrVect& dirs, StrVect& files,
-                 QByteArray& revsFilesShaBuf)
+bool Cache::load(const QString& gitDir, RevFileMap& rfm, StrVect& dirs, StrVect& files)
 {
     // check for cache file
     QString path(gitDir + C_DAT_FILE);
@@ -143,12 +140,14 @@ bool Cache::load(const QString& gitDir, RevFileMap& rfm, StrVect& dirs, StrVect&
     for (int i = 0; i < filesNum; ++i)
         stream >> files[i];
 
+    // keys are converted to binary ids, so
+    // the buffer is not needed after loading
+    QByteArray shaBuf;
     stream >> bufSize;
-    revsFilesShaBuf.clear();
-    revsFilesShaBuf.reserve(bufSize);
-    stream >> revsFilesShaBuf;
+    shaBuf.reserve(bufSize);
+    stream >> shaBuf;
 
-    const char* data = revsFilesShaBuf.constData();
+    const char* data = shaBuf.constData();
 
     while (!stream.atEnd()) {
 
@@ -156,7 +155,7 @@ bool Cache::load(const QString& gitDir, RevFileMap& rfm, StrVect& dirs, StrVect&
         *rf << stream;
 
         ShaString sha(data);
-        rfm.insert(sha, rf);
+        rfm.insert(ObjectId(sha), rf);
 
         data += 40;
         if (*data != '\0') {
@@ -15,6 +15,7 @@
 #include <QVariant>
 #include <QVector>
 #include "model/shastring.h"
+#include "model/objectid.h"
 #include "lanes.h"
 /*
    QVariant does not support size_t type used in Qt containers, this is
@@ -57,11 +58,9 @@ typedef const QString&              SCRef;
 typedef QStringList&                SList;
 typedef const QStringList&          SCList;
 typedef QVector<QString>            StrVect;
-typedef QVector<ShaString>          ShaVect;
+typedef QVector<ObjectId>           ShaVect;
 typedef QSet<QString>               ShaSet;
 
-uint qHash(const ShaString&); // optimized custom hash for sha strings
-
 namespace QGit
 {
     // minimum git version required
@@ -140,10 +139,9 @@ namespace QGit
     // git index parameters
     extern const QByteArray ZERO_SHA_BA;
     extern const ShaString  ZERO_SHA_RAW;
+    extern const ObjectId   ZERO_SHA_ID;
 
     extern const QString ZERO_SHA;
-    extern const QString CUSTOM_SHA;
-    extern const QString ALL_MERGE_FILES;
 
     // settings keys
     extern const QString ORG_KEY;
@@ -198,14 +196,16 @@ namespace QGit
         WHOLE_HISTORY_F = 1 << 12,
         RANGE_SELECT_F  = 1 << 13,
         REOPEN_REPO_F   = 1 << 14,
-        USE_CMT_MSG_F   = 1 << 15
+        USE_CMT_MSG_F   = 1 << 15,
+        LOG_ON_DEMAND_F = 1 << 16,
+        COMPACT_LANES_F = 1 << 17,
+        PARALLEL_LOG_F  = 1 << 18
     };
 
     const int FLAGS_DEF = USE_CMT_MSG_F | RANGE_SELECT_F | SMART_LBL_F | VERIFY_CMT_F | SIGN_PATCH_F | LOG_DIFF_TAB_F | MSG_ON_NEW_F;
 
     // ShaString helpers
     const ShaString toTempSha(const QString&); // use as argument only, see definition
-    const ShaString toPersistentSha(const QString&, QVector<QByteArray>&);
 
     // settings helpers
     uint flags(SCRef flagsVariable);
@@ -236,10 +236,23 @@ namespace QGit
     extern const QString BAK_EXT;
     extern const QString C_DAT_FILE;
 
+    // history cache file
+    const uint H_MAGIC  = 0xA0B0C0D1;
+    const int H_VERSION = 2;
+
+    extern const QString H_DAT_FILE;
+
     // misc
     const int MAX_DICT_SIZE    = 100003; // must be a prime number see QDict docs
     const int MAX_MENU_ENTRIES = 20;
     const int MAX_RECENT_REPOS = 7;
+    const int MAX_DISPLAY_CACHE_COST = 4 * 1024 * 1024; // bytes of decoded row strings
+    const int MAX_LONG_LOG_CACHE_COST = 1024 * 1024; // chars of on demand log messages
+    const int MAX_LANE_GLYPH_CACHE_SIZE = 1000;  // graph lane tiles
+    const int MAX_LANE_ROW_CACHE_COST = 2 * 1024 * 1024; // pixels of cached graph cells
+    const int REVS_PER_BUFFER = 100;       // about, in a 'git log' output buffer
+    const int MAX_LOG_SHARDS = 8;          // parallel 'git log', see Git::startShardedRevList()
+    const int MIN_LOG_SHARD_SIZE = 20000;  // revisions
     extern const QString QUOTE_CHAR;
     extern const QString SCRIPT_EXT;
 }
@@ -320,7 +333,7 @@ public:
     const RevFile& operator>>(QDataStream&) const;
     RevFile& operator<<(QDataStream&);
 };
-typedef QHash<ShaString, const RevFile*> RevFileMap;
+typedef QHash<ObjectId, const RevFile*> RevFileMap;
 
 
 class FileAnnotation
@@ -334,7 +347,7 @@ public:
     QString fileSha;
 };
 
-typedef QHash<ShaString, FileAnnotation> AnnotateHistory;
+typedef QHash<ObjectId, FileAnnotation> AnnotateHistory;
 
 
 class BaseEvent: public QEvent
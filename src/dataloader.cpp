@@ -6,36 +6,71 @@
     Copyright: See COPYING file that comes with this distribution
 
 */
+#include <limits.h>
 #include <QDir>
+#include <QSocketNotifier>
 #include <QTemporaryFile>
 #include "git.h"
 #include "dataloader.h"
 
-#define GUI_UPDATE_INTERVAL 500
-#define READ_BLOCK_SIZE     65535
+#ifdef USE_FIFO
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define GUI_UPDATE_INTERVAL   500
+#define FIRST_UPDATE_INTERVAL 50 // until first data, to show it soon
+#define READ_BLOCK_SIZE       65535
+#define FIFO_WINDOW_SIZE      (16 * READ_BLOCK_SIZE) // max read in one round
 
 class UnbufferedTemporaryFile : public QTemporaryFile
 {
 public:
     explicit UnbufferedTemporaryFile(QObject* p) : QTemporaryFile(p) {}
     bool unbufOpen() { return open(QIODevice::ReadOnly | QIODevice::Unbuffered); }
+
+    // revisions parsing writes '\0' terminators in the data, so we need
+    // the mapped pages to be writable, see Revision::indexData()
+    bool mapOpen() { return open(QIODevice::ReadWrite | QIODevice::Unbuffered); }
 };
 
 DataLoader::DataLoader(Git* g, FileHistory* f) : QProcess(g), git(g), fh(f)
 {
-    canceling = parsing = false;
+    canceling = isLastBuffer = isFifoClosed = isFed = false;
     isProcExited = true;
-    halfChunk = NULL;
+    mappedBuffer = NULL;
     dataFile = NULL;
+    fifoNotifier = NULL;
+    fifoFd = -1;
+    mapOfs = 0;
     loadedBytes = 0;
     guiUpdateTimer.setSingleShot(true);
+    parser = new RevParser(this, &fh->revArena, !git->isMainHistory(fh));
+    stats = git->getLoadStats(fh);
+    startTime = 0;
 
     connect(git, SIGNAL(cancelAllProcesses()), this, SLOT(on_cancel()));
     connect(&guiUpdateTimer, SIGNAL(timeout()), this, SLOT(on_timeout()));
+    connect(parser, SIGNAL(parsed()), this, SLOT(on_parsed())); // queued
 }
 
 DataLoader::~DataLoader()
 {
+    // parser thread must be stopped before our buffers go away
+    parser->cancel();
+    parser->wait();
+    delete mappedBuffer; // not yet merged, mapping is released by the history
+
+#ifdef USE_FIFO
+    delete fifoNotifier; // before to close its descriptor
+    if (fifoFd != -1)
+        ::close(fifoFd);
+
+    removeFifo(); // if not already done
+#endif
+
     // avoid a Qt warning in case we are
     // destroyed while still running
     waitForFinished(1000);
@@ -52,6 +87,18 @@ void DataLoader::on_cancel()
     if (!canceling) { // just once
         canceling = true;
         kill(); // SIGKILL (Unix and Mac), TerminateProcess (Windows)
+
+        if (fifoNotifier)
+            fifoNotifier->setEnabled(false);
+
+        // caller is going to free the history, so parser
+        // must not touch the buffers anymore when we return
+        parser->cancel();
+        parser->wait();
+        parser->discardResult(); // revisions are in history arena
+
+        if (!guiUpdateTimer.isActive()) // we were waiting for the parser
+            guiUpdateTimer.start(1);
     }
 }
 
@@ -67,27 +114,99 @@ bool DataLoader::start(SCList args, SCRef wd, SCRef buf)
     connect(this, SIGNAL(finished(int, QProcess::ExitStatus)),
             this, SLOT(on_finished(int, QProcess::ExitStatus)));
 
-    if (!createTemporaryFile() || !QGit::startProcess(this, args, buf)) {
+    startTime = LoadStats::now();
+    bool ok = createTemporaryFile() && QGit::startProcess(this, args, buf);
+    if (stats)
+        stats->add(LoadStats::SPAWN, LoadStats::now() - startTime);
+
+#ifdef USE_FIFO
+    // both ends are open now, or git is not running, so
+    // in any case name is not needed anymore
+    removeFifo();
+#endif
+    if (!ok) {
         deleteLater();
         return false;
     }
     loadTime.start();
-    guiUpdateTimer.start(GUI_UPDATE_INTERVAL);
+
+#ifdef USE_FIFO
+    if (fifoNotifier)
+        return true; // driven by fifoNotifier instead of the timer
+#endif
+    guiUpdateTimer.start(FIRST_UPDATE_INTERVAL);
     return true;
 }
 
+bool DataLoader::start(QByteArray* data)
+{
+    // parse data already available, as example the history cache,
+    // caller has already added it to history rowData, so it is
+    // parsed in place as a mapped buffer, in one round
+    if (!isProcExited) {
+        dbs("ASSERT in DataLoader::start(), called while processing");
+        return false;
+    }
+    isLastBuffer = true;
+    loadedBytes = data->size();
+    loadTime.start();
+    parser->parse(QList<QByteArray*>() << data, true, true);
+    return true;
+}
+
+bool DataLoader::startFeed()
+{
+    // data is produced in process, as example by NativeLoader, and
+    // given with feed() as it comes, no process is started
+    if (!isProcExited) {
+        dbs("ASSERT in DataLoader::startFeed(), called while processing");
+        return false;
+    }
+    isProcExited = false;
+    isFed = true;
+    startTime = LoadStats::now();
+    loadTime.start();
+    return true;
+}
+
+void DataLoader::feed(QByteArray* data, bool isLast)
+{
+    // 'data', possibly NULL, is owned by the history from now on
+    if (canceling || !isFed || isProcExited) {
+        delete data;
+        return;
+    }
+    if (data && !data->isEmpty()) {
+        fh->rowData.append(data);
+        fedData.append(data);
+    } else
+        delete data;
+
+    if (isLast) {
+        isProcExited = true;
+        if (stats)
+            stats->add(LoadStats::GIT, LoadStats::now() - startTime);
+    }
+    // when parser is busy reading resumes in on_parsed()
+    if (!parser->isBusy() && !guiUpdateTimer.isActive())
+        guiUpdateTimer.start(1);
+}
+
 void DataLoader::on_finished(int, QProcess::ExitStatus)
 {
     isProcExited = true;
 
-    if (parsing && guiUpdateTimer.isActive())
-        dbs("ASSERT in DataLoader: timer active while parsing");
+    if (stats)
+        stats->add(LoadStats::GIT, LoadStats::now() - startTime);
 
-    if (parsing == guiUpdateTimer.isActive() && !canceling)
-        dbs("ASSERT in DataLoader: inconsistent timer");
+    if (guiUpdateTimer.isActive() && parser->isBusy())
+        dbs("ASSERT in DataLoader: timer active while parsing");
 
     if (guiUpdateTimer.isActive()) // no need to wait anymore
         guiUpdateTimer.start(1);
+
+    else if (fifoNotifier && !parser->isBusy()) // read what is left in the pipe
+        guiUpdateTimer.start(1);
 }
 
 void DataLoader::on_timeout()
@@ -96,90 +215,107 @@ void DataLoader::on_timeout()
         deleteLater();
         return; // we leave with guiUpdateTimer not active
     }
-    parsing = true;
+    if (parser->isBusy()) // when streaming, reading resumes in on_parsed()
+        return;
+
+    // process could exit while we are reading so save the flag now
+    isLastBuffer = isProcExited;
+    const ulong newBytes = (isFed ? readFedData(isLastBuffer) : readNewData(isLastBuffer));
+    if (stats && startTime && newBytes && !loadedBytes)
+        stats->add(LoadStats::FIRST_DATA, LoadStats::now() - startTime);
 
-    // process could exit while we are processing so save the flag now
-    bool lastBuffer = isProcExited;
-    loadedBytes += readNewData(lastBuffer);
-    emit newDataReady(fh); // inserting in list view is about 3% of total time
+    loadedBytes += newBytes;
 
-    if (lastBuffer) {
+    if (parser->isBusy())
+        return; // timer will be restarted by on_parsed()
+
+    if (isLastBuffer) { // nothing more to parse
+        emit newDataReady(fh);
         emit loaded(fh, loadedBytes, loadTime.elapsed(), true, "", "");
         deleteLater();
 
-    } else if (isProcExited) { // exited while parsing
-        dbs("Exited while parsing!!!!");
-        guiUpdateTimer.start(1);
-    } else
-        guiUpdateTimer.start(GUI_UPDATE_INTERVAL);
-
-    parsing = false;
+    } else if (fifoNotifier) // nothing read, wait for new data
+        fifoNotifier->setEnabled(!isFifoClosed);
+    else if (!isFed) // otherwise feed() restarts us
+        guiUpdateTimer.start(loadedBytes ? GUI_UPDATE_INTERVAL : FIRST_UPDATE_INTERVAL);
 }
 
-void DataLoader::parseSingleBuffer(const QByteArray& ba)
+void DataLoader::on_parsed()
 {
-    if (ba.size() == 0 || canceling)
-        return;
-
-    int ofs = 0, newOfs, bz = ba.size();
+    RevParser::Result r;
 
-    /* Due to unknown reasons randomly first byte
-     * of 'ba' is 0, this seems to happen only when
-     * using QFile::read(), i.e. with temporary file
-     * interface. Until we discover the real reason
-     * workaround this skipping the bogus byte
-     */
-    if (ba.at(0) == 0 && bz > 1 && !halfChunk)
-        ofs++;
-
-    while (bz - ofs > 0) {
-
-        if (!halfChunk) {
+    if (canceling || !parser->takeResult(r))
+        return;
 
-            newOfs = git->addChunk(fh, ba, ofs);
-            if (newOfs == -1)
-                break; // half chunk detected
+    fh->rowData += r.buffers;
 
-            ofs = newOfs;
+    if (mappedBuffer) {
+        if (r.consumed > 0)
+            fh->rowData.append(mappedBuffer);
+        else { // not even a whole record, try again later
+            dataFile->unmap((uchar*)mappedBuffer->constData());
+            delete mappedBuffer;
+        }
+        mapOfs += r.consumed;
+        mappedBuffer = NULL;
+    }
+    // only insertion in the history is left to GUI thread
+    const qint64 insertTime = LoadStats::now();
+    FOREACH (QVector<Revision*>, it, r.revs) {
+        if (*it)
+            git->addRevision(fh, *it);
+        else
+            fh->setEarlyOutputState(true);
+    }
+    fh->reconcileEarlyOutput(false);
 
-        } else { // less then 1% of cases with READ_BLOCK_SIZE = 64KB
+    if (stats) {
+        stats->add(LoadStats::PARSE, r.parseTime);
+        stats->add(LoadStats::INSERT, LoadStats::now() - insertTime);
+    }
 
-            int end = ba.indexOf('\0');
-            if (end == -1) // consecutives half chunks
-                break;
+    // when streaming rounds are much shorter, so update the view at most
+    // once each GUI_UPDATE_INTERVAL, the first rows as soon as possible
+    if (   !(fifoNotifier || isFed) || isLastBuffer || guiUpdateTime.isNull()
+        || guiUpdateTime.elapsed() >= GUI_UPDATE_INTERVAL) {
 
-            ofs = end + 1;
-            baAppend(&halfChunk, ba.constData(), ofs);
-            fh->rowData.append(halfChunk);
-            addSplittedChunks(halfChunk);
-            halfChunk = NULL;
-        }
+        guiUpdateTime.start();
+        emit newDataReady(fh); // inserting in list view is about 3% of total time
     }
-    // save any remaining half chunk
-    if (bz - ofs > 0)
-        baAppend(&halfChunk, ba.constData() + ofs,  bz - ofs);
+    if (isLastBuffer) {
+        emit loaded(fh, loadedBytes, loadTime.elapsed(), true, "", "");
+        deleteLater();
+
+    } else if (isProcExited) // exited while parsing
+        guiUpdateTimer.start(1);
+    else if (fifoNotifier) // read again as soon as there is new data
+        fifoNotifier->setEnabled(!isFifoClosed);
+    else if (isFed) { // fed meanwhile or wait for feed()
+        if (!fedData.isEmpty())
+            guiUpdateTimer.start(1);
+    } else
+        guiUpdateTimer.start(GUI_UPDATE_INTERVAL);
 }
 
-void DataLoader::addSplittedChunks(const QByteArray* hc)
+ulong DataLoader::readFedData(bool lastBuffer)
 {
-    if (hc->at(hc->size() - 1) != 0) {
-        dbs("ASSERT in DataLoader, bad half chunk");
-        return;
+    // buffers are already in history, records can span more of them
+    QList<QByteArray*> buffers(fedData);
+    fedData.clear();
+
+    ulong cnt = 0;
+    FOREACH (QList<QByteArray*>, it, buffers)
+        cnt += (*it)->size();
+
+    if (lastBuffer) { // be sure stream is null terminated
+        QByteArray* zb = new QByteArray(1, '\0');
+        fh->rowData.append(zb);
+        buffers.append(zb);
     }
-    // do not assume we have only one chunk in hc
-    int ofs = 0;
-    while (ofs != -1 && ofs != (int)hc->size())
-        ofs = git->addChunk(fh, *hc, ofs);
-}
+    if (!buffers.isEmpty())
+        parser->parse(buffers, false, lastBuffer);
 
-void DataLoader::baAppend(QByteArray** baPtr, const char* ascii, int len)
-{
-    if (*baPtr)
-        // we cannot use QByteArray::append(const char*)
-        // because 'ascii' is not '\0' terminating
-        (*baPtr)->append(QByteArray::fromRawData(ascii, len));
-    else
-        *baPtr = new QByteArray(ascii, len);
+    return cnt;
 }
 
 // *************** git interface facility dependant code *****************************
@@ -217,7 +353,7 @@ ulong DataLoader::readNewData(bool lastBuffer)
         return 0;
     }
     fh->rowData.append(ba);
-    parseSingleBuffer(*ba);
+    parser->parse(QList<QByteArray*>() << ba, false, lastBuffer);
     return ba->size();
 }
 
@@ -228,8 +364,69 @@ bool DataLoader::createTemporaryFile()
 
 #else // temporary file as data exchange facility
 
+#ifdef USE_MMAP
+
+ulong DataLoader::readNewData(bool lastBuffer)
+{
+#ifdef USE_FIFO
+    if (fifoNotifier)
+        return readFifoData(lastBuffer);
+#endif
+    bool ok = dataFile &&
+             (dataFile->isOpen() || (dataFile->exists() && dataFile->mapOpen()));
+
+    if (!ok)
+        return 0;
+
+    // mapped pages must stay valid as long as the revisions pointing
+    // to them, so file ownership is moved to the history, that will
+    // unmap and remove the file when cleared
+    if (dataFile->parent() == this) {
+        dataFile->setParent(NULL);
+        fh->mappedFiles.append(dataFile);
+    }
+    qint64 size = dataFile->size();
+    qint64 len = size - mapOfs;
+    if (len <= 0)
+        return 0;
+
+    // a QByteArray cannot address more than INT_MAX bytes, so in case
+    // of a bigger window the rest is mapped at the next round
+    if (len > INT_MAX) {
+        len = INT_MAX;
+        lastBuffer = isLastBuffer = false;
+    }
+
+    /*
+       We map from the first not yet parsed record up to the current
+       end of file, so that a record split across two rounds is simply
+       mapped again, as a whole, at the next round. No data is copied,
+       QByteArray::fromRawData() does not take ownership of the pages.
+
+       Parsed length is known only when parser is done, so at most one
+       window is in flight, see on_parsed(). In case of last buffer
+       parser takes care also of the not '\0' terminated last record.
+    */
+    uchar* data = dataFile->map(mapOfs, len);
+    if (!data) {
+        dbs("ASSERT in DataLoader: unable to map temporary file");
+        return 0;
+    }
+    mappedBuffer = new QByteArray(QByteArray::fromRawData((const char*)data, len));
+    parser->parse(QList<QByteArray*>() << mappedBuffer, true, lastBuffer);
+
+    // count only new data, the first part could have been mapped already
+    return (ulong)(mapOfs + len - (qint64)loadedBytes);
+}
+
+#else // read the temporary file in heap allocated blocks
+
 ulong DataLoader::readNewData(bool lastBuffer)
 {
+#ifdef USE_FIFO
+    if (fifoNotifier)
+        return readFifoData(lastBuffer);
+#endif
     bool ok = dataFile &&
              (dataFile->isOpen() || (dataFile->exists() && dataFile->unbufOpen()));
 
@@ -238,6 +435,7 @@ ulong DataLoader::readNewData(bool lastBuffer)
 
     ulong cnt = 0;
     qint64 readPos = dataFile->pos();
+    QList<QByteArray*> buffers;
 
     while (true) {
         // this is the ONLY deep copy involved in the whole loading
@@ -262,7 +460,7 @@ ulong DataLoader::readNewData(bool lastBuffer)
 
         cnt += len;
         fh->rowData.append(ba);
-        parseSingleBuffer(*ba);
+        buffers.append(ba);
 
         // avoid reading small chunks if data producer is still running
         if (len < READ_BLOCK_SIZE && !lastBuffer)
@@ -271,13 +469,22 @@ ulong DataLoader::readNewData(bool lastBuffer)
     if (lastBuffer) { // be sure stream is null terminated
         QByteArray* zb = new QByteArray(1, '\0');
         fh->rowData.append(zb);
-        parseSingleBuffer(*zb);
+        buffers.append(zb);
     }
+    if (!buffers.isEmpty())
+        parser->parse(buffers, false, lastBuffer);
+
     return cnt;
 }
 
+#endif // USE_MMAP
+
 bool DataLoader::createTemporaryFile()
 {
+#ifdef USE_FIFO
+    if (!git->isMainHistory(fh) && createFifo())
+        return true;
+#endif
     // redirect 'git log' output to a temporary file
     dataFile = new UnbufferedTemporaryFile(this);
 
@@ -320,4 +527,106 @@ bool DataLoader::createTemporaryFile()
     return true;
 }
 
+#ifdef USE_FIFO
+
+bool DataLoader::createFifo()
+{
+/*
+   A named pipe is used in place of the temporary file. QProcess opens
+   the output file in our process, before forking, and opening the write
+   end of a pipe blocks until there is a reader, so read end is opened
+   first, in non blocking mode, and watched by a QSocketNotifier.
+*/
+    QTemporaryFile tmp(QDir::tempPath() + "/qgit_fifo");
+    if (!tmp.open()) // just to get an unique name
+        return false;
+
+    const QString name(tmp.fileName());
+    tmp.remove();
+
+    const QByteArray path(QFile::encodeName(name));
+    if (::mkfifo(path.constData(), 0600) != 0)
+        return false;
+
+    fifoPath = name; // removed by removeFifo()
+
+    fifoFd = ::open(path.constData(), O_RDONLY | O_NONBLOCK);
+    if (fifoFd == -1) {
+        removeFifo();
+        return false;
+    }
+#ifdef F_SETPIPE_SZ
+    ::fcntl(fifoFd, F_SETPIPE_SZ, FIFO_WINDOW_SIZE); // fewer wake ups, Linux only
+#endif
+    fifoNotifier = new QSocketNotifier(fifoFd, QSocketNotifier::Read, this);
+    connect(fifoNotifier, SIGNAL(activated(int)), this, SLOT(on_fifoReady()));
+
+    setStandardOutputFile(fifoPath);
+    return true;
+}
+
+void DataLoader::removeFifo()
+{
+    if (!fifoPath.isEmpty()) {
+        ::unlink(QFile::encodeName(fifoPath).constData());
+        fifoPath.clear(); // the name could be reused by someone else
+    }
+}
+
+void DataLoader::on_fifoReady()
+{
+    // stop notifications until parser is done with this data
+    fifoNotifier->setEnabled(false);
+    on_timeout();
+}
+
+ulong DataLoader::readFifoData(bool lastBuffer)
+{
+/*
+   We read only what is already in the pipe, up to FIFO_WINDOW_SIZE, or all
+   of it once process is exited. While parser is busy nobody reads, so when
+   the pipe is full 'git log' is blocked in write(), this back pressure
+   keeps data in flight bounded by the window size, whatever is the size
+   of the whole output.
+*/
+    ulong cnt = 0;
+    QList<QByteArray*> buffers;
+
+    while (lastBuffer || cnt < FIFO_WINDOW_SIZE) {
+
+        QByteArray* ba = new QByteArray();
+        ba->resize(READ_BLOCK_SIZE);
+        ssize_t len = ::read(fifoFd, ba->data(), READ_BLOCK_SIZE);
+
+        if (len <= 0) { // pipe is empty (EAGAIN) or closed
+            delete ba;
+            if (len == -1 && errno == EINTR)
+                continue;
+
+            // once closed the pipe is always readable, so stop
+            // watching it and wait for the process to exit
+            isFifoClosed = (len == 0);
+            break;
+
+        } else if (len < ba->size())
+            ba->resize((int)len);
+
+        cnt += (ulong)len;
+        fh->rowData.append(ba);
+        buffers.append(ba);
+    }
+    if (lastBuffer) { // be sure stream is null terminated
+        fifoNotifier->setEnabled(false);
+        QByteArray* zb = new QByteArray(1, '\0');
+        fh->rowData.append(zb);
+        buffers.append(zb);
+    }
+    if (!buffers.isEmpty())
+        parser->parse(buffers, false, lastBuffer);
+
+    return cnt;
+}
+
+#endif // USE_FIFO
+
 #endif // USE_QPROCESS
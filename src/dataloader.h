@@ -11,8 +11,11 @@
 #include <QTime>
 #include <QTimer>
 #include "filehistory.h"
+#include "revparser.h"
 
 class Git;
+class LoadStats;
+class QSocketNotifier;
 class QString;
 class UnbufferedTemporaryFile;
 
@@ -20,6 +23,25 @@ class UnbufferedTemporaryFile;
 // a temporary file (default). Uncomment following line to use QProcess
 // #define USE_QPROCESS
 
+// when using the temporary file, where available, the file is memory mapped
+// and revisions point directly into the mapped pages, so to avoid copying
+// the data in heap allocated blocks. Comment out following line to read
+// the file in blocks instead
+//
+// in any case parsing is done by a RevParser worker thread, only one
+// job is in flight at a time and GUI thread just merges the results
+#if !defined(USE_QPROCESS) && !defined(Q_OS_WIN32)
+#define USE_MMAP
+#endif
+
+// file history output, with the whole patches, could be huge, so where
+// available it is streamed through a named pipe instead of the temporary
+// file, 'git log' is blocked while parser is busy and nothing is written
+// to disk. Comment out following line to always use the temporary file
+#if !defined(USE_QPROCESS) && !defined(Q_OS_WIN32)
+#define USE_FIFO
+#endif
+
 class DataLoader : public QProcess
 {
     Q_OBJECT
@@ -27,6 +49,9 @@ public:
     DataLoader(Git *g, FileHistory *f);
     ~DataLoader();
     bool start(const QStringList &args, const QString &wd, const QString &buf);
+    bool start(QByteArray *data);
+    bool startFeed();
+    void feed(QByteArray *data, bool isLast);
 
 signals:
     void newDataReady(const FileHistory*);
@@ -37,23 +62,41 @@ private slots:
     void on_cancel();
     void on_cancel(const FileHistory*);
     void on_timeout();
+    void on_parsed();
+#ifdef USE_FIFO
+    void on_fifoReady();
+#endif
 
 private:
-    void parseSingleBuffer(const QByteArray &ba);
-    void baAppend(QByteArray **src, const char *ascii, int len);
-    void addSplittedChunks(const QByteArray *halfChunk);
     bool createTemporaryFile();
     ulong readNewData(bool lastBuffer);
+#ifdef USE_FIFO
+    bool createFifo();
+    void removeFifo();
+    ulong readFifoData(bool lastBuffer);
+#endif
+    ulong readFedData(bool lastBuffer);
 
     Git *git;
     FileHistory *fh;
-    QByteArray *halfChunk;
+    LoadStats *stats; // of main history only, NULL otherwise
+    RevParser *parser;
+    QByteArray *mappedBuffer; // currently parsed window, when memory mapped
     UnbufferedTemporaryFile *dataFile;
+    QSocketNotifier *fifoNotifier; // read end of the pipe, when streaming
+    QString fifoPath;
+    int fifoFd;
+    QList<QByteArray*> fedData; // given with feed() and not yet parsed
     QTime loadTime;
+    qint64 startTime; // usecs, see LoadStats
+    QTime guiUpdateTime; // of last newDataReady(), when streaming
     QTimer guiUpdateTimer;
+    qint64 mapOfs;
     ulong loadedBytes;
     bool isProcExited;
-    bool parsing;
+    bool isLastBuffer;
+    bool isFifoClosed;
+    bool isFed; // data is produced in process, see startFeed()
     bool canceling;
 };
 
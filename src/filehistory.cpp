@@ -19,15 +19,16 @@
 
 using namespace QGit;
 
-FileHistory::FileHistory(QObject* p, Git* g) : QAbstractItemModel(p), git(g)
+FileHistory::FileHistory(QObject* p, Git* g) : QAbstractItemModel(p), git(g), graph(revs)
 {
     headerInfo << "Graph" << "Id" << "Short Log" << "Author" << "Author Date";
     lns = new Lanes();
+    displayCache.setMaxCost(QGit::MAX_DISPLAY_CACHE_COST);
     revs.reserve(QGit::MAX_DICT_SIZE);
     clear(); // after _headerInfo is set
 
-    connect(git, SIGNAL(newRevsAdded(const FileHistory*, const QVector<ShaString>&)),
-            this, SLOT(on_newRevsAdded(const FileHistory*, const QVector<ShaString>&)));
+    connect(git, SIGNAL(newRevsAdded(const FileHistory*, const QVector<ObjectId>&)),
+            this, SLOT(on_newRevsAdded(const FileHistory*, const QVector<ObjectId>&)));
 
     connect(git, SIGNAL(loadCompleted(const FileHistory*, const QString&)),
             this, SLOT(on_loadCompleted(const FileHistory*, const QString&)));
@@ -66,54 +67,252 @@ int FileHistory::row(SCRef sha) const
 
 const QString FileHistory::sha(int row) const
 {
-    return (row < 0 || row >= rowCnt ? "" : QString(revOrder.at(row)));
+    return (row < 0 || row >= rowCnt ? "" : revOrder.at(row).toString());
 }
 
-void FileHistory::flushTail()
+const FileHistory::DisplayRow FileHistory::displayRow(int row) const
 {
-    if (earlyOutputCnt < 0 || earlyOutputCnt >= revOrder.count()) {
-        dbp("ASSERT in FileHistory::flushTail(), earlyOutputCnt is %1", earlyOutputCnt);
-        return;
-    }
-    int cnt = revOrder.count() - earlyOutputCnt + 1;
-    while (cnt > 0) {
-        const ShaString& sha = revOrder.last();
-        const Revision* c = revs[sha];
-        delete c;
-        revs.remove(sha);
-        revOrder.pop_back();
-        cnt--;
+    // strings are decoded from log data once per shown
+    // row, and not again at each repaint, only data() fills the cache
+    const DisplayRow* cached = displayCache.object(row);
+    if (cached)
+        return *cached;
+
+    const Revision* r = graph.revision(row);
+    DisplayRow* dr = new DisplayRow;
+    dr->shortLog = r->shortLog();
+    dr->author = r->author();
+
+    const DisplayRow ret(*dr);
+    int cost = (int)sizeof(DisplayRow) + (ret.shortLog.size() + ret.author.size()) * (int)sizeof(QChar);
+    displayCache.insert(row, dr, cost); // 'dr' is deleted if too big
+    return ret;
+}
+
+void FileHistory::reserve(int revsCnt)
+{
+    // sized up front with the number of revisions to load, so that
+    // containers are not grown and rehashed again and again meanwhile
+    const int cnt = revOrder.count() + revsCnt;
+    revs.reserve(cnt);
+    revOrder.reserve(cnt);
+    graph.reserve(cnt);
+    revArena.reserve(cnt);
+    rowData.reserve(rowData.count() + revsCnt / QGit::REVS_PER_BUFFER + 1);
+}
+
+void FileHistory::setEarlyOutputState(bool b)
+{
+    // a new early output is compared again from the first row, so
+    // final output revisions received until now, still hidden, go away
+    if (earlyOutputTail != -1)
+        removeRows(earlyOutputTail, revOrder.count());
+
+    earlyOutputTail = -1;
+    earlyOutputCnt = (b ? earlyOutputCntBase : -1);
+}
+
+void FileHistory::removeRows(int from, int to)
+{
+// rows in [from, to) are dropped and following ones moved up. A revision
+// could be also in a following row, received again, so it is removed from
+// revs only if not already replaced there
+
+    git->cancelLaneBuilder(this);
+
+    for (int i = from; i < to; i++) {
+        const Revision* r = graph.revision(i);
+        if (revs.value(revOrder.at(i)) == r)
+            revs.remove(revOrder.at(i));
+
+        revArena.destroy(r);
     }
+    revOrder.remove(from, to - from);
+    graph.remove(from, to);
+    reach.clear();
+
     // reset all lanes, will be redrawn
     for (int i = earlyOutputCntBase; i < revOrder.count(); i++) {
-        Revision* c = const_cast<Revision*>(revs[revOrder[i]]);
+        Revision* c = const_cast<Revision*>(graph.revision(i));
+        c->orderIdx = i;
         c->lanes.clear();
     }
     firstFreeLane = earlyOutputCntBase;
     lns->clear();
-    rowCnt = revOrder.count();
-    reset();
+    laneMarks.clear();
+    displayCache.clear();
 }
 
-void FileHistory::clear(bool complete)
+void FileHistory::reconcileEarlyOutput(bool force)
 {
-    if (!complete) {
-        if (revOrder.count() > 0)
-            flushTail();
+/*
+   Final output differs from the early one from row 'earlyOutputCnt' on, so
+   its revisions are appended hidden after the shown ones and, when they are
+   enough to cover the shown rows, or at the end of loading, they take their
+   place in one go. So the view is updated in place, instead of losing the
+   tail and filling it again.
+*/
+    if (earlyOutputTail == -1)
         return;
+
+    const int first = earlyOutputCnt;
+    const int staleCnt = earlyOutputTail - first;
+    if (!force && revOrder.count() - earlyOutputTail < staleCnt)
+        return;
+
+    removeRows(first, earlyOutputTail);
+    earlyOutputTail = earlyOutputCnt = -1; // early output is over
+
+    if (rowCnt > revOrder.count()) { // shorter final output, should not happen
+        rowCnt = revOrder.count();
+        reset();
+
+    } else if (first < rowCnt)
+        emit dataChanged(index(first, 0), index(rowCnt - 1, columnCount(QModelIndex()) - 1));
+}
+
+void FileHistory::lanesBuilt(int from, int to)
+{
+    // rows in [from, to) have their lanes now, shown ones are repainted
+    to = qMin(to, rowCnt);
+    if (from < to)
+        emit dataChanged(index(from, QGit::GRAPH_COL), index(to - 1, QGit::GRAPH_COL));
+}
+
+void FileHistory::spliceTail(int tailRow, int headCnt)
+{
+// called at the end of an incremental refresh, new revisions have been
+// appended from 'tailRow' on but they are all descendants of, or not
+// related to, the old ones, so moving them on top keeps the topological
+// order. First 'headCnt' rows, an old working dir revision, are dropped.
+//
+// Old rows are laid out as before from the first one where lanes state,
+// after the new rows, matches the one saved there by the old layout, so
+// only the rows until there are laid out again and the tail keeps its
+// lanes. Near refs and reachability are indexed by row instead, so they
+// will be computed again by Git::indexTree()
+
+    git->cancelLaneBuilder(this);
+
+    const int newCnt = revOrder.count() - tailRow;
+    const int shift = newCnt - headCnt;
+
+    ShaVect ro;
+    ro.reserve(revOrder.count() - headCnt);
+    for (int i = tailRow; i < revOrder.count(); i++)
+        ro.append(revOrder.at(i));
+
+    for (int i = headCnt; i < tailRow; i++)
+        ro.append(revOrder.at(i));
+
+    revOrder = ro;
+    graph.spliceTail(tailRow, headCnt);
+
+    // saved states of old rows, and the one after the last laid out, move
+    // with their rows. If some new rows have been laid out already, the
+    // state is past the old ones and nothing can be reused
+    int oldEnd = headCnt;
+    if ((int)firstFreeLane <= tailRow) {
+        oldEnd = firstFreeLane;
+        laneMarks.insert(oldEnd, *lns);
+    }
+    QMap<int, Lanes> marks;
+    QMap<int, Lanes>::const_iterator it(laneMarks.constBegin());
+    for ( ; it != laneMarks.constEnd() && it.key() <= oldEnd; ++it)
+        if (it.key() > headCnt)
+            marks.insert(it.key() + shift, it.value());
+
+    laneMarks = marks;
+    oldEnd += shift;
+
+    const int cnt = revOrder.count();
+    for (int i = 0; i < cnt; i++) {
+        Revision* c = const_cast<Revision*>(graph.revision(i));
+        c->orderIdx = i;
+        c->descRefs.clear();
+        c->ancRefs.clear();
+        c->descBranches.clear();
+        c->descRefsMaster = c->ancRefsMaster = c->descBrnMaster = -1;
+    }
+    // fake lanes of working dir and unapplied patches rows are not computed
+    // so they are kept. Rows are laid out here only while there is some old
+    // layout to reach, and not too many, the others in background
+    const int stop = (oldEnd > newCnt ? qMin(oldEnd, (int)SPLICE_LANES_ROWS) : 0);
+    bool same = false;
+    int row = 0;
+    lns->clear();
+    for ( ; row < stop; row++) {
+
+        if (laneMarks.contains(row)) {
+            same = lns->isSameState(laneMarks.value(row));
+            if (same)
+                break;
+        }
+        if (laneMarks.contains(row) || isLaneMark(row))
+            laneMarks.insert(row, *lns);
+
+        Revision* c = const_cast<Revision*>(graph.revision(row));
+        if ((c->isDiffCache || c->isUnApplied) && !c->lanes.isEmpty())
+            continue;
+
+        QVector<LaneType> lanes;
+        Git::updateLanes(*c, *lns, ObjectId(c->sha()), lanes);
+        c->lanes = laneStore.intern(lanes);
     }
+    if (same) {
+        *lns = laneMarks.value(oldEnd);
+        firstFreeLane = oldEnd;
+    } else {
+        // old layout not reached, following rows will be laid out again
+        for (int i = row; i < cnt; i++) {
+            Revision* c = const_cast<Revision*>(graph.revision(i));
+            if (!c->isDiffCache && !c->isUnApplied)
+                c->lanes.clear();
+        }
+        while (!laneMarks.isEmpty() && (laneMarks.end() - 1).key() >= row)
+            laneMarks.erase(laneMarks.end() - 1);
+
+        firstFreeLane = row;
+    }
+    reach.clear();
+    displayCache.clear();
+    rowCnt = cnt;
+    reset();
+}
+
+bool FileHistory::isLaneMark(int row)
+{
+    // states are saved before rows 1, 2, 4, ... and then every LANE_MARK_ROWS
+    // rows, so that a refresh with few new rows finds one soon
+    return (row > 0 && ((row & (row - 1)) == 0 || row % LANE_MARK_ROWS == 0));
+}
+
+void FileHistory::clear()
+{
     git->cancelDataLoading(this);
+    git->cancelLaneBuilder(this);
 
-    qDeleteAll(revs);
+    // revisions are destructed here, memory is released in blocks
+    FOREACH (RevMap, it, revs)
+        (*it)->~Revision();
+    revArena.clear();
+    laneStore.clear();
     revs.clear();
     revOrder.clear();
+    graph.clear();
+    reach.clear();
+    displayCache.clear();
     firstFreeLane = loadTime = earlyOutputCntBase = 0;
+    earlyOutputTail = -1; // rows are gone already
     setEarlyOutputState(false);
     lns->clear();
+    laneMarks.clear();
     fNames.clear();
     curFNames.clear();
     qDeleteAll(rowData);
     rowData.clear();
+    qDeleteAll(mappedFiles); // unmap and remove, after revisions are gone
+    mappedFiles.clear();
 
     if (testFlag(REL_DATE_F)) {
         secs = QDateTime::currentDateTime().toTime_t();
@@ -122,13 +321,16 @@ void FileHistory::clear(bool complete)
         secs = 0;
         headerInfo[4] = "Author Date";
     }
+    // fixed until next complete reload, so that refreshes are consistent
+    logOnDemand = testFlag(LOG_ON_DEMAND_F);
+    lns->setCompact(testFlag(COMPACT_LANES_F));
     rowCnt = revOrder.count();
     annIdValid = false;
     reset();
     emit headerDataChanged(Qt::Horizontal, 0, 4);
 }
 
-void FileHistory::on_newRevsAdded(const FileHistory* fh, const QVector<ShaString>& shaVec)
+void FileHistory::on_newRevsAdded(const FileHistory* fh, const QVector<ObjectId>& shaVec)
 {
     if (fh != this) // signal newRevsAdded() is broadcast
         return;
@@ -138,6 +340,10 @@ void FileHistory::on_newRevsAdded(const FileHistory* fh, const QVector<ShaString
     if (!renamedRevs.isEmpty() || !renamedPatches.isEmpty())
         return;
 
+    // final output is not shown until it replaces the early one
+    if (earlyOutputTail != -1)
+        return;
+
     // do not attempt to insert 0 rows since the inclusive range would be invalid
     if (rowCnt == shaVec.count())
         return;
@@ -238,7 +444,7 @@ QVariant FileHistory::data(const QModelIndex& index, int role) const
     if (!index.isValid() || role != Qt::DisplayRole)
         return no_value; // fast path, 90% of calls ends here!
 
-    const Revision* r = git->revLookup(revOrder.at(index.row()), this);
+    const Revision* r = graph.revision(index.row());
     if (!r)
         return no_value;
 
@@ -252,10 +458,10 @@ QVariant FileHistory::data(const QModelIndex& index, int role) const
         return (annIdValid ? rowCnt - index.row() : QVariant());
 
     if (col == QGit::LOG_COL)
-        return r->shortLog();
+        return shortLog(index.row());
 
     if (col == QGit::AUTH_COL)
-        return r->author();
+        return author(index.row());
 
     if (col == QGit::TIME_COL && r->sha() != QGit::ZERO_SHA_RAW) {
 
@@ -2,9 +2,14 @@
 #define FILEHISTORY_H
 
 #include <QAbstractItemModel>
+#include <QCache>
+#include <QMap>
 #include "common.h"
 #include "git.h"
 #include "lanes.h"
+#include "model/reachindex.h"
+#include "model/revgraph.h"
+#include "model/revisionarena.h"
 #include "exceptionmanager.h"
 
 class Cache;
@@ -13,6 +18,7 @@ class Domain;
 class MyProcess;
 class Git;
 class Annotate;
+class QFile;
 
 class FileHistory : public QAbstractItemModel
 {
@@ -20,12 +26,13 @@ class FileHistory : public QAbstractItemModel
 public:
     FileHistory(QObject* parent, Git* git);
     ~FileHistory();
-    void clear(bool complete = true);
+    void clear();
     const QString sha(int row) const;
     int row(SCRef sha) const;
     const QStringList fileNames() const { return fNames; }
     void resetFileNames(SCRef fn);
-    void setEarlyOutputState(bool b = true) { earlyOutputCnt = (b ? earlyOutputCntBase : -1); }
+    void reserve(int revsCnt);
+    void setEarlyOutputState(bool b = true);
     void setAnnIdValid(bool b = true) { annIdValid = b; }
 
     virtual QVariant data(const QModelIndex &index, int role) const;
@@ -41,7 +48,7 @@ public slots:
     void on_changeFont(const QFont&);
 
 private slots:
-    void on_newRevsAdded(const FileHistory*, const QVector<ShaString>&);
+    void on_newRevsAdded(const FileHistory*, const QVector<ObjectId>&);
     void on_loadCompleted(const FileHistory*, const QString&);
 
 private:
@@ -49,21 +56,45 @@ private:
     friend class DataLoader;
     friend class Git;
 
-    void flushTail();
+    enum {
+        LANE_MARK_ROWS = 4096,     // rows between saved lanes states, after the first ones
+        SPLICE_LANES_ROWS = 32768  // rows laid out by spliceTail(), the others in background
+    };
+    struct DisplayRow {
+        QString shortLog;
+        QString author;
+    };
+    void removeRows(int from, int to);
+    void reconcileEarlyOutput(bool force);
+    void spliceTail(int tailRow, int headCnt);
+    static bool isLaneMark(int row);
+    void lanesBuilt(int from, int to);
+    const DisplayRow displayRow(int row) const;
+    const QString shortLog(int row) const { return displayRow(row).shortLog; }
+    const QString author(int row) const { return displayRow(row).author; }
     const QString timeDiff(unsigned long secs) const;
 
     Git* git;
+    RevisionArena revArena; // backing store of revs
     RevMap revs;
     ShaVect revOrder;
+    RevGraph graph; // by row, in sync with revOrder
+    ReachIndex reach; // by row, main history only, see Git::indexTree()
     Lanes* lns;
+    LaneStore laneStore; // lanes of revs, see Revision::lanes
     uint firstFreeLane;
+    QMap<int, Lanes> laneMarks; // lanes state before some rows, see spliceTail()
     QList<QByteArray*> rowData;
+    QList<QFile*> mappedFiles; // backing store of rowData, when memory mapped
     QList<QVariant> headerInfo;
+    mutable QCache<int, DisplayRow> displayCache; // by row, only recently shown ones
     int rowCnt;
     bool annIdValid;
+    bool logOnDemand; // main history only, see Git::getLongLog()
     unsigned long secs;
     int loadTime;
     int earlyOutputCnt;
+    int earlyOutputTail; // first hidden row of final output, or -1
     int earlyOutputCntBase;
     QStringList fNames;
     QStringList curFNames;
@@ -7,6 +7,7 @@
 
 */
 #include <QApplication>
+#include <QBitArray>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
@@ -18,11 +19,20 @@
 #include <QTextCodec>
 #include <QTextDocument>
 #include <QTextStream>
+#include <QThread>
 #include "annotate.h"
 #include "cache.h"
 #include "git.h"
+#include "historycache.h"
+#include "git/catfilebatch.h"
+#include "git/commitgraph.h"
+#include "git/nativelog.h"
+#include "git/shardedlog.h"
+#include "lanebuilder.h"
+#include "nativeloader.h"
 #include "lanes.h"
 #include "myprocess.h"
+#include "treeindexer.h"
 
 #include <QPair>
 #include <QSettings>
@@ -61,6 +71,15 @@ Git::Git(QObject* p) : QObject(p), m_references(this)
 
     fileCacheAccessed = cacheNeedsUpdate = isMergeHead = false;
     isStGIT = isGIT = loadingUnAppliedPatches = isTextHighlighterFound = false;
+    mainHistoryLoaded = false;
+    refreshTailRow = -1;
+    oldWorkDirRev = NULL;
+    loadingFromCache = historyCacheNeedsUpdate = false;
+    catFile = NULL;
+    treeIndexer = NULL;
+    laneBuilder = NULL;
+    nativeLoader = NULL;
+    longLogCache.setMaxCost(MAX_LONG_LOG_CACHE_COST);
     errorReportingEnabled = true; // report errors if run() fails
     curDomain = NULL;
     revData = NULL;
@@ -69,6 +88,10 @@ Git::Git(QObject* p) : QObject(p), m_references(this)
 
 Git::~Git()
 {
+    cancelIndexTree();
+    cancelLaneBuilder(revData);
+    cancelNativeLoader();
+    delete catFile;
 }
 
 void Git::checkEnvironment()
@@ -288,7 +311,7 @@ const QStringList Git::getAllRefNames(uint mask, bool onlyLoaded)
     return names;
 }
 
-const QString Git::getRevInfo(const ShaString &sha)
+const QString Git::getRevInfo(const ObjectId& sha)
 {
     if (sha.isNull() || !m_references.containsSha(sha)) {
         return "";
@@ -414,13 +437,18 @@ void Git::cancelDataLoading(const FileHistory* fh)
 
 const Revision* Git::revLookup(SCRef sha, const FileHistory* fh) const
 {
-    return revLookup(toTempSha(sha), fh);
+    return revLookup(ObjectId(sha), fh);
 }
 
 const Revision* Git::revLookup(const ShaString& sha, const FileHistory* fh) const
+{
+    return revLookup(ObjectId(sha), fh);
+}
+
+const Revision* Git::revLookup(const ObjectId& id, const FileHistory* fh) const
 {
     const RevMap& r = (fh ? fh->revs : revData->revs);
-    return (sha.latin1() ? r.value(sha) : NULL);
+    return (!id.isNull() ? r.value(id) : NULL);
 }
 
 bool Git::run(SCRef runCmd, QString* runOutput, QObject* receiver, SCRef buf)
@@ -497,13 +525,16 @@ int Git::findFileIndex(const RevFile& rf, SCRef name)
 
 const QString Git::getLaneParent(SCRef fromSHA, int laneNum)
 {
+// lanes are walked as shown, so folded ones of compact mode, marked
+// by LANE_OVERFLOW, cannot be followed
+
     const Revision* rs = revLookup(fromSHA);
-    if (!rs)
+    if (!rs || laneNum < 0)
         return "";
 
     for (int idx = rs->orderIdx - 1; idx >= 0; idx--) {
 
-        const Revision* r = revLookup(revData->revOrder[idx]);
+        const Revision* r = revData->graph.revision(idx);
         if (laneNum >= r->lanes.count())
             return "";
 
@@ -516,9 +547,12 @@ const QString Git::getLaneParent(SCRef fromSHA, int laneNum)
                 if (isHead(type))
                     parNum++;
 
+                if (type == LANE_OVERFLOW || laneNum == 0)
+                    return "";
+
                 type = r->lanes[--laneNum];
             }
-            return r->parent(parNum);
+            return ((uint)parNum < r->parentsCount() ? QString(r->parent(parNum)) : "");
         }
     }
     return "";
@@ -531,8 +565,9 @@ const QStringList Git::getChilds(SCRef parent)
     if (!r)
         return childs;
 
-    for (int i = 0; i < r->childs.count(); i++)
-        childs.append(revData->revOrder[r->childs[i]]);
+    const RevGraph& g = revData->graph;
+    for (int i = 0, cnt = g.childsCount(r->orderIdx); i < cnt; i++)
+        childs.append(revData->revOrder[g.child(r->orderIdx, i)].toString());
 
     // reorder childs by loading order
     QStringList::iterator itC(childs.begin());
@@ -762,10 +797,10 @@ void Git::getWorkDirFiles(SList files, SList dirs, RevFile::StatusFlag status)
 
 bool Git::isNothingToCommit()
 {
-    if (!revsFiles.contains(ZERO_SHA_RAW))
+    if (!revsFiles.contains(ZERO_SHA_ID))
         return true;
 
-    const RevFile* rf = revsFiles[ZERO_SHA_RAW];
+    const RevFile* rf = revsFiles[ZERO_SHA_ID];
     return (rf->count() == workingDirInfo.otherFiles.count());
 }
 
@@ -808,6 +843,22 @@ bool Git::isSameFiles(SCRef tree1Sha, SCRef tree2Sha)
     return !isChanged;
 }
 
+bool Git::isAncestor(SCRef anc, SCRef sha, bool* known)
+{
+// answered by main history reachability index, without running git,
+// 'known' is set to false if index is not available for these revisions
+
+    const ReachIndex& ri = revData->reach;
+    const Revision* a = revLookup(anc);
+    const Revision* r = revLookup(sha);
+    const bool ok = (!ri.isEmpty() && a && r && a->orderIdx < ri.count()
+                     && r->orderIdx < ri.count());
+    if (known)
+        *known = ok;
+
+    return ok && ri.isAncestor(a->orderIdx, r->orderIdx);
+}
+
 const QStringList Git::getDescendantBranches(SCRef sha, bool shaOnly)
 {
     QStringList tl;
@@ -815,21 +866,21 @@ const QStringList Git::getDescendantBranches(SCRef sha, bool shaOnly)
     if (!r || (r->descBrnMaster == -1))
         return tl;
 
-    const QVector<int>& nr = revLookup(revData->revOrder[r->descBrnMaster])->descBranches;
+    const QVector<int>& nr = revData->graph.revision(r->descBrnMaster)->descBranches;
 
     for (int i = 0; i < nr.count(); i++) {
 
-        const ShaString& sha = revData->revOrder[nr[i]];
+        const ObjectId& id = revData->revOrder[nr[i]];
         if (shaOnly) {
-            tl.append(sha);
+            tl.append(id.toString());
             continue;
         }
-        SCRef cap = " (" + sha + ") ";
-        QString joinedBranches = m_references.filter(sha, Reference::BRANCH).getNames().join(" ");
+        SCRef cap = " (" + id.toString() + ") ";
+        QString joinedBranches = m_references.filter(id, Reference::BRANCH).getNames().join(" ");
         if (!joinedBranches.isEmpty())
             tl.append(joinedBranches.append(cap));
 
-        QString joinedRemoteBranches = m_references.filter(sha, Reference::REMOTE_BRANCH).getNames().join(" ");
+        QString joinedRemoteBranches = m_references.filter(id, Reference::REMOTE_BRANCH).getNames().join(" ");
         if (!joinedRemoteBranches.isEmpty())
             tl.append(joinedRemoteBranches.append(cap));
     }
@@ -847,15 +898,15 @@ const QStringList Git::getNearTags(bool goDown, SCRef sha)
     if (nearRefsMaster == -1)
         return tl;
 
-    const QVector<int>& nr = goDown ? revLookup(revData->revOrder[nearRefsMaster])->descRefs :
-                                      revLookup(revData->revOrder[nearRefsMaster])->ancRefs;
+    const Revision* m = revData->graph.revision(nearRefsMaster);
+    const QVector<int>& nr = (goDown ? m->descRefs : m->ancRefs);
 
     for (int i = 0; i < nr.count(); i++) {
 
-        const ShaString& sha = revData->revOrder[nr[i]];
-        SCRef cap = " (" + sha + ")";
+        const ObjectId& id = revData->revOrder[nr[i]];
+        SCRef cap = " (" + id.toString() + ")";
 
-        QString text = m_references.filter(sha, Reference::TAG).getNames().join(cap);
+        QString text = m_references.filter(id, Reference::TAG).getNames().join(cap);
         if (!text.isEmpty())
             tl.append(text.append(cap));
     }
@@ -882,7 +933,82 @@ const QString Git::getLastCommitMsg()
         return "";
     }
 
-    return c->shortLog() + "\n\n" + c->longLog().trimmed();
+    return c->shortLog() + "\n\n" + getLongLog(c).trimmed();
+}
+
+const QString Git::getLongLog(const Revision* r)
+{
+    // with LOG_ON_DEMAND_F main history is loaded without log message
+    // bodies, they are read when needed and only recent ones are kept
+    if (!revData || !revData->logOnDemand || r->isDiffCache || r->isUnApplied)
+        return r->longLog();
+
+    const ObjectId id(r->sha());
+    const QString* cached = longLogCache.object(id);
+    if (cached)
+        return *cached;
+
+    if (!catFile)
+        catFile = new CatFileBatch(workDir);
+
+    QByteArray data;
+    if (!catFile->read(id.toString(), data))
+        return r->longLog();
+
+    QString* log = new QString(QString::fromAscii(CatFileBatch::commitBody(data)));
+    longLogCache.insert(id, log, qMax(log->length(), 1));
+    return *log;
+}
+
+bool Git::grepLongLogs(const FileHistory* fh, SCRef wildcard, ShaSet& shas)
+{
+    // with LOG_ON_DEMAND_F reading log messages one by one to filter them
+    // would be a git round trip for each row, so git is asked once for the
+    // revisions whose message matches. Returns false if messages are in
+    // memory and can be searched as usual
+    if (!isMainHistory(fh) || !fh->logOnDemand)
+        return false;
+
+    // wildcard to extended regexp, '$' is our quote char so matches any
+    QString re;
+    for (int i = 0; i < wildcard.length(); i++) {
+        const QChar c(wildcard.at(i));
+        if (c == '*')
+            re.append(".*");
+        else if (c == '?' || c == '$')
+            re.append('.');
+        else if (QString(".(){}+^|\\").contains(c))
+            re.append('\\').append(c);
+        else
+            re.append(c);
+    }
+    // fake revisions are unknown to git, their messages are in memory
+    const QRegExp filter(wildcard, Qt::CaseInsensitive, QRegExp::Wildcard);
+    QString buf;
+    shas.clear();
+    FOREACH (ShaVect, it, fh->revOrder) {
+        const Revision* r = fh->revs.value(*it);
+        if (r && (r->isDiffCache || r->isUnApplied)) {
+            if (r->longLog().contains(filter))
+                shas.insert(it->toString());
+        } else
+            buf.append(it->toString()).append('\n');
+    }
+    QString runOutput;
+    const QString cmd("git rev-list --no-walk=unsorted --stdin -i -E " + quote("--grep=" + re));
+    if (!buf.isEmpty() && !run(cmd, &runOutput, NULL, buf))
+        return false;
+
+    // git greps the subject too, while the in memory filter searches only
+    // the message body, so candidates are checked again on their bodies,
+    // that are read just for them, to get the same rows in both cases
+    const QStringList matches(runOutput.split('\n', QString::SkipEmptyParts));
+    FOREACH_SL (it, matches) {
+        const Revision* r = revLookup(*it, fh);
+        if (r && getLongLog(r).contains(filter))
+            shas.insert(*it);
+    }
+    return true;
 }
 
 const QString Git::getNewCommitMsg()
@@ -973,8 +1099,8 @@ const QString Git::getDesc(SCRef sha, QRegExp& shortLogRE, QRegExp& longLogRE, b
 
             if (c->isUnApplied || c->isApplied) {
 
-                QStringList patches(m_references.filter(toTempSha(sha), Reference::APPLIED).getNames().join(" "));
-                patches += m_references.filter(toTempSha(sha), Reference::UN_APPLIED).getNames().join(" ");
+                QStringList patches(m_references.filter(ObjectId(sha), Reference::APPLIED).getNames().join(" "));
+                patches += m_references.filter(ObjectId(sha), Reference::UN_APPLIED).getNames().join(" ");
                 ts << formatList(patches, "Patch");
             } else {
                 ts << formatList(c->parents(), "Parent", false);
@@ -984,7 +1110,7 @@ const QString Git::getDesc(SCRef sha, QRegExp& shortLogRE, QRegExp& longLogRE, b
                 ts << formatList(getNearTags(optGoDown, sha), "Precedes");
             }
         }
-        QString longLog(c->longLog());
+        QString longLog(getLongLog(c));
         if (showHeader) {
             longLog.prepend(QString("\n") + c->shortLog() + "\n");
         }
@@ -1023,7 +1149,7 @@ const QString Git::getDesc(SCRef sha, QRegExp& shortLogRE, QRegExp& longLogRE, b
     return text;
 }
 
-const RevFile* Git::insertNewFiles(SCRef sha, SCRef data)
+const RevFile* Git::insertNewFiles(const ObjectId& id, SCRef data)
 {
     /* we use an independent FileNamesLoader to avoid data
      * corruption if we are loading file names in background
@@ -1034,7 +1160,7 @@ const RevFile* Git::insertNewFiles(SCRef sha, SCRef data)
     parseDiffFormat(*rf, data, fl);
     flushFileNames(fl);
 
-    revsFiles.insert(toPersistentSha(sha, revsFilesShaBackupBuf), rf);
+    revsFiles.insert(id, rf);
     return rf;
 }
 
@@ -1061,9 +1187,9 @@ bool Git::runDiffTreeWithRenameDetection(SCRef runCmd, QString* runOutput)
 
 const RevFile* Git::getAllMergeFiles(const Revision* r)
 {
-    SCRef mySha(ALL_MERGE_FILES + r->sha());
-    if (revsFiles.contains(toTempSha(mySha)))
-        return revsFiles[toTempSha(mySha)];
+    const ObjectId mergeId(r->sha(), ObjectId::MERGE_FILES_ID);
+    if (revsFiles.contains(mergeId))
+        return revsFiles[mergeId];
 
     EM_PROCESS_EVENTS; // 'git diff-tree' could be slow
 
@@ -1072,7 +1198,7 @@ const RevFile* Git::getAllMergeFiles(const Revision* r)
     if (!runDiffTreeWithRenameDetection(runCmd, &runOutput))
         return NULL;
 
-    return insertNewFiles(mySha, runOutput);
+    return insertNewFiles(mergeId, runOutput);
 }
 
 const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef path)
@@ -1102,7 +1228,7 @@ const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef pa
 
         // we insert a dummy revision file object. It will be
         // overwritten at each request but we don't care.
-        return insertNewFiles(CUSTOM_SHA, runOutput);
+        return insertNewFiles(ObjectId::custom(), runOutput);
     }
     if (revsFiles.contains(r->sha()))
         return revsFiles[r->sha()]; // ZERO_SHA search arrives here
@@ -1122,7 +1248,7 @@ const RevFile* Git::getFiles(SCRef sha, SCRef diffToSha, bool allFiles, SCRef pa
         return revsFiles[r->sha()];
 
     cacheNeedsUpdate = true;
-    return insertNewFiles(sha, runOutput);
+    return insertNewFiles(ObjectId(sha), runOutput);
 }
 
 bool Git::startFileHistory(SCRef sha, SCRef startingFileName, FileHistory* fh)
@@ -1189,7 +1315,7 @@ void Git::getFileFilter(SCRef path, ShaSet& shaSet) const
         const RevFile* rf = revsFiles[*it];
         for (int i = 0; i < rf->count(); ++i)
             if (filePath(*rf, i).contains(rx)) {
-                shaSet.insert(*it);
+                shaSet.insert((*it).toString());
                 break;
             }
     }
@@ -1200,8 +1326,8 @@ bool Git::getPatchFilter(SCRef exp, bool isRegExp, ShaSet& shaSet)
     shaSet.clear();
     QString buf;
     FOREACH (ShaVect, it, revData->revOrder)
-        if (*it != ZERO_SHA_RAW)
-            buf.append(*it).append('\n');
+        if (*it != ZERO_SHA_ID)
+            buf.append((*it).toString()).append('\n');
 
     if (buf.isEmpty())
         return true;
@@ -1711,7 +1837,7 @@ Revision* Git::fakeRevData(SCRef sha, SCList parents, SCRef author, SCRef date,
 
     fh->rowData.append(ba);
     int dummy;
-    Revision* c = new Revision(*ba, 0, idx, &dummy, !isMainHistory(fh));
+    Revision* c = new (&fh->revArena) Revision(*ba, 0, idx, &dummy, !isMainHistory(fh));
     return c;
 }
 
@@ -1726,7 +1852,7 @@ const Revision* Git::fakeWorkDirRev(SCRef parent, SCRef log, SCRef longLog, int
     QStringList parents(parent);
     Revision* c = fakeRevData(ZERO_SHA, parents, author, date, log, longLog, patch, idx, fh);
     c->isDiffCache = true;
-    c->lanes.append(LANE_EMPTY);
+    c->lanes = fh->laneStore.intern(QVector<LaneType>(1, LANE_EMPTY));
     return c;
 }
 
@@ -1778,17 +1904,40 @@ void Git::getDiffIndex() {
     workingDirInfo.otherFiles = getOthersFiles();
 
     // now mockup a RevFile
-    revsFiles.insert(ZERO_SHA_RAW, fakeWorkDirRevFile(workingDirInfo));
+    revsFiles.insert(ZERO_SHA_ID, fakeWorkDirRevFile(workingDirInfo));
 
     // then mockup the corresponding Rev
     SCRef log = (isNothingToCommit() ? "Nothing to commit" : "Working dir changes");
     const Revision* r = fakeWorkDirRev(head, log, status, revData->revOrder.count(), revData);
-    revData->revs.insert(ZERO_SHA_RAW, r);
-    revData->revOrder.append(ZERO_SHA_RAW);
+    revData->revs.insert(ZERO_SHA_ID, r);
+    revData->revOrder.append(ZERO_SHA_ID);
+    revData->graph.append(r);
     revData->earlyOutputCntBase = revData->revOrder.count();
 
-    // finally send it to GUI
-    emit newRevsAdded(revData, revData->revOrder);
+    // finally send it to GUI, when refreshing at the end
+    if (refreshTailRow == -1)
+        emit newRevsAdded(revData, revData->revOrder);
+}
+
+const QStringList Git::getHistoryHeads() const {
+// revisions of main history without children, any revision
+// created later is a descendant of them or is not related
+
+    const RevGraph& g = revData->graph;
+    QBitArray isParent(g.count());
+    for (int i = 0; i < g.count(); i++)
+        for (int y = 0, pc = g.parentsCount(i); y < pc; y++) {
+            int p = g.parent(i, y);
+            if (p != -1)
+                isParent.setBit(p);
+        }
+
+    QStringList heads;
+    for (int i = 0; i < g.count(); i++)
+        if (!isParent.testBit(i) && revData->revOrder.at(i) != ZERO_SHA_ID)
+            heads.append(revData->revOrder.at(i).toString());
+
+    return heads;
 }
 
 void Git::parseDiffFormatLine(RevFile& rf, SCRef line, int parNum, FileNamesLoader& fl) {
@@ -1906,6 +2055,12 @@ void Git::parseDiffFormat(RevFile& rf, SCRef buf, FileNamesLoader& fl) {
 
 bool Git::startParseProc(SCList initCmd, FileHistory* fh, SCRef buf) {
 
+    DataLoader* dl = createDataLoader(fh);
+    return dl->start(initCmd, workDir, buf);
+}
+
+DataLoader* Git::createDataLoader(FileHistory* fh) {
+
     DataLoader* dl = new DataLoader(this, fh); // auto-deleted when done
 
     connect(this, SIGNAL(cancelLoading(const FileHistory*)),
@@ -1919,24 +2074,35 @@ bool Git::startParseProc(SCList initCmd, FileHistory* fh, SCRef buf) {
             SLOT(on_loaded(FileHistory*, ulong, int,
             bool, const QString&, const QString&)));
 
-    return dl->start(initCmd, workDir, buf);
+    return dl;
 }
 
-bool Git::startRevList(SCList args, FileHistory* fh) {
+const QStringList Git::getLogCmd(const FileHistory* fh) {
+// 'git log' with the output format expected by the parser, see Revision
 
-    QString baseCmd("git log --topo-order --no-color "
+    QString baseCmd("git log --no-color "
 
 #ifndef Q_OS_WIN32
                     "--log-size " // FIXME broken on Windows
 #endif
-                    "--parents --boundary -z "
+                    "--parents -z "
                     "--pretty=format:%m%HX%PX%n%cn<%ce>%n%an<%ae>%n%at%n%s%n");
 
-    // we don't need log message body for file history
-    if (isMainHistory(fh))
+    // we don't need log message body for file history, nor for main
+    // history when it is loaded on demand, see getLongLog()
+    if (isMainHistory(fh) && !fh->logOnDemand)
         baseCmd.append("%b");
 
-    QStringList initCmd(baseCmd.split(' '));
+    return baseCmd.split(' ');
+}
+
+bool Git::startRevList(SCList args, FileHistory* fh, bool boundary) {
+
+    QStringList initCmd(getLogCmd(fh));
+    initCmd << "--topo-order";
+    if (boundary)
+        initCmd << "--boundary";
+
     if (!isMainHistory(fh)) {
     /*
        NOTE: we don't use '--remove-empty' option because
@@ -1946,8 +2112,10 @@ bool Git::startRevList(SCList args, FileHistory* fh) {
        the file deletion revision.
     */
         initCmd << QString("-r -m -p --full-index").split(' ');
-    } else
-        {} // initCmd << QString("--early-output"); currently disabled
+    } else if (refreshTailRow == -1)
+        // show the first revisions while git is still sorting the
+        // others, not when new revisions are appended hidden anyway
+        initCmd << "--early-output";
 
     return startParseProc(initCmd + args, fh, QString());
 }
@@ -1981,17 +2149,34 @@ void Git::stop(bool saveCache) {
     // to terminate. Note that process could still keep
     // running for a while although silently
     emit cancelAllProcesses(); // non blocking
+    cancelIndexTree();
+    cancelLaneBuilder(revData);
+    cancelNativeLoader();
 
     // after cancelAllProcesses() procFinished() is not called anymore
     // TODO perhaps is better to call procFinished() also if process terminated
     // incorrectly as QProcess does. BUt first we need to fix FileView::on_loadCompleted()
     emit fileNamesLoad(1, revsFiles.count() - filesLoadingStartOfs);
 
+    if (historyCacheNeedsUpdate && saveCache) {
+
+        // history must be complete, not in the middle of a loading
+        historyCacheNeedsUpdate = false;
+        QStringList args;
+        if (   mainHistoryLoaded && !loadArguments.filteredLoading
+            && !isStGIT && getPlainRefsArgs(args)) {
+
+            SHOW_MSG("Saving history cache. Please wait...");
+            if (!HistoryCache::save(gitDir, args, getHistoryHeads(),
+                                    !revData->logOnDemand, revData))
+                dbs("ERROR unable to save history cache");
+        }
+    }
     if (cacheNeedsUpdate && saveCache) {
 
         cacheNeedsUpdate = false;
         if (!filesLoadingCurSha.isEmpty()) // we are in the middle of a loading
-            revsFiles.remove(toTempSha(filesLoadingCurSha)); // remove partial data
+            revsFiles.remove(ObjectId(filesLoadingCurSha)); // remove partial data
 
         if (!revsFiles.isEmpty()) {
             SHOW_MSG("Saving cache. Please wait...");
@@ -2003,10 +2188,24 @@ void Git::stop(bool saveCache) {
 
 void Git::clearRevs() {
 
+    // not in revs anymore, see refreshIncrementally()
+    revData->revArena.destroy(oldWorkDirRev);
+    oldWorkDirRev = NULL;
+    cancelIndexTree();
+    cancelLaneBuilder(revData);
+    cancelNativeLoader();
+    refreshTailRow = -1;
+    mainHistoryLoaded = loadingFromCache = historyCacheNeedsUpdate = false;
+    cachedHeads.clear();
+    delete catFile; // could be another repository
+    catFile = NULL;
+    longLogCache.clear();
+    loadStats.reset();
+
     revData->clear();
     firstNonStGitPatch = "";
     workingDirInfo.clear();
-    revsFiles.remove(ZERO_SHA_RAW);
+    revsFiles.remove(ZERO_SHA_ID);
 }
 
 void Git::clearFileNames() {
@@ -2017,7 +2216,6 @@ void Git::clearFileNames() {
     dirNamesMap.clear();
     dirNamesVec.clear();
     fileNamesVec.clear();
-    revsFilesShaBackupBuf.clear();
     cacheNeedsUpdate = false;
 }
 
@@ -2113,6 +2311,336 @@ bool Git::init(SCRef wd, bool askForRange, const QStringList* passedArgs, bool o
     }
 }
 
+bool Git::getPlainRefsArgs(QStringList& args) const {
+// new history is a superset of the current one only if arguments are a
+// plain list of refs, returns them in 'args', with HEAD if not given
+
+    args = loadArguments.args;
+    FOREACH_SL (it, args) {
+        bool isRefsOpt = (*it == "--all" || *it == "--branches" || *it == "--tags" || *it == "--remotes");
+        if ((*it).startsWith('^') || (*it).contains("..") || ((*it).startsWith('-') && !isRefsOpt))
+            return false;
+    }
+    if (args.isEmpty())
+        args << "HEAD";
+
+    return true;
+}
+
+bool Git::areReachable(SCList heads, SCList args) {
+// revisions that are not reachable anymore, as example after a reset
+// or a rebase, cannot be removed from history, so caller must reload
+// everything. Fails also if some of 'heads' has been pruned
+
+    QString lost;
+    const QString runCmd("git rev-list --max-count=1 " + heads.join(" ") + " --not " + args.join(" "));
+    return run(runCmd, &lost) && lost.trimmed().isEmpty();
+}
+
+bool Git::startNewRevList(SCList args, SCList heads, SCRef msg) {
+// loads revisions not reachable from 'heads', they are appended hidden
+// to main history and moved on top of it at the end, see on_loaded()
+
+    mainHistoryLoaded = false;
+    refreshTailRow = revData->revOrder.count();
+
+    // old working dir revision is still shown until
+    // new revisions are added, so free it only then
+    if (revData->revs.contains(ZERO_SHA_ID)) {
+        oldWorkDirRev = revData->revs[ZERO_SHA_ID];
+        revData->revs.remove(ZERO_SHA_ID);
+    }
+    workingDirInfo.clear();
+    revsFiles.remove(ZERO_SHA_ID);
+
+    if (testFlag(DIFF_INDEX_F)) {
+        SHOW_MSG(msg + "working directory changed files...");
+        getDiffIndex(); // blocking
+    }
+    SHOW_MSG(msg + "revisions...");
+
+    // old heads are already loaded, so no boundary
+    return startRevList(args + (QStringList() << "--not") + heads, revData, false);
+}
+
+bool Git::refreshIncrementally() {
+// called instead of init() when refreshing the same repository, loads
+// only revisions not already in main history and adds them on top of
+// it at the end of loading. Returns false if a full reload is needed.
+// Must be called after stop()
+
+    QStringList args;
+    if (!mainHistoryLoaded || loadArguments.filteredLoading || isStGIT || !getPlainRefsArgs(args))
+        return false;
+
+    const ShaVect& ro = revData->revOrder;
+    if (revData->revs.contains(ZERO_SHA_ID) && ro.first() != ZERO_SHA_ID)
+        return false;
+
+    const QStringList heads(getHistoryHeads());
+    if (heads.isEmpty())
+        return false;
+
+    try {
+        setThrowOnStop(true);
+
+        const QString msg1("Path is '" + workDir + "'    Refreshing ");
+        loadStats.reset();
+
+        SHOW_MSG(msg1 + "refs...");
+        if (!getRefs())
+            dbs("WARNING: no tags or heads found");
+
+        if (!areReachable(heads, args)) {
+            setThrowOnStop(false);
+            return false;
+        }
+        if (!startNewRevList(args, heads, msg1))
+            SHOW_MSG("ERROR: unable to start 'git log'");
+
+        setThrowOnStop(false);
+        return true;
+
+    } catch (int i) {
+
+        setThrowOnStop(false);
+
+        if (isThrowOnStopRaised(i, "refreshing")) {
+            EM_THROW_PENDING;
+            return true;
+        }
+        const QString info("Exception \'" + EM_DESC(i) + "\' "
+                           "not handled in refreshIncrementally...re-throw");
+        dbs(info);
+        throw;
+    }
+}
+
+bool Git::startCachedRevList() {
+// loads main history saved at last exit, if still valid, and then asks
+// git only for the new revisions, as a refresh does, see on_loaded()
+
+    QStringList args, heads;
+    if (!getPlainRefsArgs(args))
+        return false;
+
+    QFile* file;
+    QByteArray* ba = HistoryCache::load(gitDir, args, !revData->logOnDemand, heads, &file);
+    if (!ba)
+        return false;
+
+    if (!areReachable(heads, args)) {
+        delete ba;
+        delete file; // after the buffer pointing to it
+        return false;
+    }
+    revData->rowData.append(ba);
+    if (file)
+        revData->mappedFiles.append(file);
+
+    loadingFromCache = true;
+    cachedHeads = heads;
+    return createDataLoader(revData)->start(ba);
+}
+
+bool Git::startNativeRevList() {
+// reads main history directly from repository objects, without 'git log',
+// in background and loading it as it comes, then, as with the history
+// cache, asks git for anything still missing
+
+#ifdef USE_NATIVE_LOG
+    QStringList args;
+    if (!getPlainRefsArgs(args) || !NativeLog::isSupported(gitDir))
+        return false;
+
+    QString tips;
+    if (!run("git rev-list --no-walk " + args.join(" "), &tips))
+        return false;
+
+    DataLoader* dl = createDataLoader(revData);
+    if (!dl->startFeed()) {
+        delete dl;
+        return false;
+    }
+    nativeFeed = dl;
+    nativeLoader = new NativeLoader(this, gitDir, tips.split('\n', QString::SkipEmptyParts),
+                                    !revData->logOnDemand);
+    connect(nativeLoader, SIGNAL(dataReady()), this, SLOT(on_nativeDataReady()));
+    nativeLoader->start();
+
+    loadingFromCache = historyCacheNeedsUpdate = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Git::cancelNativeLoader() {
+// loader being fed, if any, is canceled with cancelLoading() as usual
+
+    if (!nativeLoader)
+        return;
+
+#ifdef USE_NATIVE_LOG
+    nativeLoader->disconnect(this);
+    delete nativeLoader;
+#endif
+    nativeLoader = NULL;
+    nativeFeed = NULL;
+}
+
+void Git::on_nativeDataReady() {
+
+#ifdef USE_NATIVE_LOG
+    // signal could come from an already deleted loader, do not use it
+    NativeLoader* nl = nativeLoader;
+    if (!nl || sender() != nl)
+        return;
+
+    QList<QByteArray*> data;
+    const NativeLoader::State state = nl->takeData(data);
+
+    if (!nativeFeed) { // canceled
+        qDeleteAll(data);
+        cancelNativeLoader();
+        return;
+    }
+    if (state == NativeLoader::FAILED) {
+        qDeleteAll(data);
+        cancelNativeLoader();
+        fallBackOnGitLog();
+        return;
+    }
+    if (state != NativeLoader::WALKING && cachedHeads.isEmpty()) { // first data
+        reserveRevs(nl->count());
+        cachedHeads = nl->heads();
+    }
+    FOREACH (QList<QByteArray*>, it, data)
+        nativeFeed->feed(*it, false);
+
+    if (state == NativeLoader::DONE) {
+        nativeFeed->feed(NULL, true); // on_loaded() will ask git for the rest
+        cancelNativeLoader(); // done, just free it
+    }
+#endif
+}
+
+void Git::fallBackOnGitLog() {
+// a faster loading of main history failed, possibly after some revisions
+// have been already loaded, so drop them and load all with 'git log'
+
+    revData->clear(); // cancels loaders of main history
+    loadingFromCache = false;
+    cachedHeads.clear();
+    loadNewRevisions();
+}
+
+bool Git::startShardedRevList() {
+// formatting in 'git log' is the slow part of loading and uses only one
+// core, so with PARALLEL_LOG_F revisions are listed in topological order
+// by 'git rev-list', much faster, and then formatted by many 'git log'
+// processes in parallel, one for each contiguous slice of the list. As
+// with the native reader, git is asked for anything missing at the end
+
+    const int shardsCnt = qMin(QThread::idealThreadCount(), MAX_LOG_SHARDS);
+    QStringList args;
+    if (!testFlag(PARALLEL_LOG_F) || shardsCnt < 2 || !getPlainRefsArgs(args))
+        return false;
+
+    // list from the tips, so that is consistent if refs change meanwhile
+    QString tips;
+    if (!run("git rev-list --no-walk " + args.join(" "), &tips))
+        return false;
+
+    const QStringList heads(tips.split('\n', QString::SkipEmptyParts));
+    if (heads.isEmpty())
+        return false;
+
+    DataLoader* dl = createDataLoader(revData);
+    if (!dl->startFeed()) {
+        delete dl;
+        return false;
+    }
+    ShardedLog* sl = new ShardedLog(this, revData, dl); // auto-deleted when done
+    connect(sl, SIGNAL(listed(int)), this, SLOT(on_shardsListed(int)));
+    connect(sl, SIGNAL(failed()), this, SLOT(fallBackOnGitLog()));
+
+    QStringList logCmd(getLogCmd(revData));
+    logCmd << "--no-walk=unsorted" << "--stdin";
+    if (!sl->start(logCmd, heads, workDir, shardsCnt)) {
+        delete dl;
+        return false;
+    }
+    loadingFromCache = historyCacheNeedsUpdate = true;
+    cachedHeads = heads;
+    return true;
+}
+
+void Git::on_shardsListed(int revsCnt) {
+
+    reserveRevs(revsCnt);
+}
+
+void Git::loadNewRevisions() {
+// second step of loading from history cache
+
+    const QString msg1("Path is '" + workDir + "'    Loading ");
+
+    try {
+        setThrowOnStop(true);
+
+        QStringList args;
+        getPlainRefsArgs(args); // already checked in startCachedRevList()
+
+        if (!startNewRevList(args, cachedHeads, msg1))
+            SHOW_MSG("ERROR: unable to start 'git log'");
+
+        cachedHeads.clear();
+        setThrowOnStop(false);
+
+    } catch (int i) {
+
+        setThrowOnStop(false);
+
+        if (isThrowOnStopRaised(i, "loading new revisions")) {
+            EM_THROW_PENDING;
+            return;
+        }
+        const QString info("Exception \'" + EM_DESC(i) + "\' "
+                           "not handled in loadNewRevisions...re-throw");
+        dbs(info);
+        throw;
+    }
+}
+
+int Git::countRevs() {
+// a cheap guess of the revisions to load, to size history containers.
+// A commit-graph file gives the count of all the commits for free, that
+// is an upper bound only when a plain list of refs is loaded, for a single
+// branch is a bit too much but still much better than growing one revision
+// at a time. Returns 0 when there is no reliable guess
+
+    QStringList args;
+    if (loadArguments.filteredLoading || !getPlainRefsArgs(args))
+        return 0;
+
+#ifdef USE_NATIVE_LOG
+    CommitGraph graph(NativeLog::objectsDir(gitDir));
+    return (graph.isValid() ? graph.count() : 0);
+#else
+    return 0;
+#endif
+}
+
+void Git::reserveRevs(int cnt) {
+
+    if (cnt <= 0)
+        return;
+
+    revData->reserve(cnt + 1); // plus working dir
+    revsFiles.reserve(revsFiles.count() + cnt + 1);
+}
+
 void Git::init2() {
 
     const QString msg1("Path is '" + workDir + "'    Loading ");
@@ -2125,6 +2653,17 @@ void Git::init2() {
     try {
         setThrowOnStop(true);
 
+        reserveRevs(countRevs());
+
+        // try first the history cache, then the native reader and
+        // the parallel 'git log', working dir is loaded after them
+        if (!loadArguments.filteredLoading && !isStGIT) {
+            SHOW_MSG(msg1 + "cached revisions...");
+            if (startCachedRevList() || startNativeRevList() || startShardedRevList()) {
+                setThrowOnStop(false);
+                return;
+            }
+        }
         // load working dir files
         if (!loadArguments.filteredLoading && testFlag(DIFF_INDEX_F)) {
             SHOW_MSG(msg1 + "working directory changed files...");
@@ -2162,7 +2701,14 @@ void Git::init2() {
 
 void Git::on_newDataReady(const FileHistory* fh) {
 
+    if (isMainHistory(fh) && refreshTailRow != -1)
+        return; // new revisions are shown all together at the end
+
+    const qint64 startTime = LoadStats::now();
     emit newRevsAdded(fh , fh->revOrder);
+
+    if (isMainHistory(fh))
+        loadStats.add(LoadStats::MODEL, LoadStats::now() - startTime);
 }
 
 void Git::on_loaded(FileHistory* fh, ulong byteSize, int loadTime,
@@ -2174,10 +2720,42 @@ void Git::on_loaded(FileHistory* fh, ulong byteSize, int loadTime,
     }
     if (normalExit) { // do not send anything if killed
 
+        if (isMainHistory(fh)) {
+            loadStats.add(LoadStats::TOTAL, (qint64)loadTime * 1000);
+            loadStats.addBytes(byteSize);
+        }
+        if (isMainHistory(fh) && loadingFromCache) {
+
+            // cached revisions are shown, now ask git for the new ones
+            loadingFromCache = false;
+            on_newDataReady(fh);
+            fh->loadTime += loadTime;
+            loadNewRevisions();
+            return;
+        }
+        // what is still hidden of the final output is shown now
+        fh->reconcileEarlyOutput(true);
+
+        if (isMainHistory(fh) && refreshTailRow != -1) {
+
+            // incremental refresh, put new revisions on top
+            fh->spliceTail(refreshTailRow, oldWorkDirRev ? 1 : 0);
+            fh->revArena.destroy(oldWorkDirRev);
+            fh->earlyOutputCntBase = (fh->revs.contains(ZERO_SHA_ID) ? 1 : 0);
+            oldWorkDirRev = NULL;
+            refreshTailRow = -1;
+        }
         on_newDataReady(fh);
 
         if (!loadingUnAppliedPatches) {
 
+            if (isMainHistory(fh)) {
+                mainHistoryLoaded = true;
+                loadStats.setRevs(fh->revs.count());
+                emit loadStatsChanged();
+                startLaneBuilder(fh);
+            }
+
             fh->loadTime += loadTime;
 
             uint kb = byteSize / 1024;
@@ -2199,6 +2777,7 @@ void Git::on_loaded(FileHistory* fh, ulong byteSize, int loadTime,
     if (loadingUnAppliedPatches) {
         loadingUnAppliedPatches = false;
         revData->lns->clear(); // again to reset lanes
+        revData->laneMarks.clear();
         init2(); // continue with loading of remaining revisions
     }
 }
@@ -2292,18 +2871,17 @@ void Git::loadFileCache() {
     if (!fileCacheAccessed) {
 
         fileCacheAccessed = true;
-        QByteArray shaBuf;
-        if (Cache::load(gitDir, revsFiles, dirNamesVec, fileNamesVec, shaBuf)) {
-            revsFilesShaBackupBuf.append(shaBuf);
+        if (Cache::load(gitDir, revsFiles, dirNamesVec, fileNamesVec))
             populateFileNamesMap();
-        } else
+        else
             dbs("ERROR: unable to load file names cache");
     }
 }
 
 void Git::loadFileNames() {
 
-    indexTree(); // we are sure data loading is finished at this point
+    indexTree(); // we are sure data loading is finished at this point,
+                 // in background, loading of file names goes on
 
     int revCnt = 0;
     QString diffTreeBuf;
@@ -2312,7 +2890,7 @@ void Git::loadFileNames() {
         if (!revsFiles.contains(*it)) {
             const Revision* c = revLookup(*it);
             if (c->parentsCount() == 1) { // skip initials and merges
-                diffTreeBuf.append(*it).append('\n');
+                diffTreeBuf.append((*it).toString()).append('\n');
                 revCnt++;
             }
         }
@@ -2328,63 +2906,51 @@ void Git::loadFileNames() {
 }
 
 bool Git::filterEarlyOutputRev(FileHistory* fh, Revision* rev) {
+// final output sends again the early output revisions, already shown, so
+// they are filtered out while they are the same. From first mismatch on
+// revisions are added hidden, see FileHistory::reconcileEarlyOutput()
+
+    if (fh->earlyOutputTail != -1)
+        return false;
 
     if (fh->earlyOutputCnt < fh->revOrder.count()) {
 
-        const ShaString& sha = fh->revOrder[fh->earlyOutputCnt++];
-        const Revision* c = revLookup(sha, fh);
-        if (c) {
-            if (rev->sha() != sha || rev->parents() != c->parents()) {
-                // mismatch found! set correct value, 'rev' will
-                // overwrite 'c' upon returning
-                rev->orderIdx = c->orderIdx;
-                revData->clear(false); // flush the tail
-            } else
-                return true; // filter out 'rev'
+        const ObjectId& id = fh->revOrder[fh->earlyOutputCnt];
+        const Revision* c = fh->graph.revision(fh->earlyOutputCnt);
+        if (ObjectId(rev->sha()) == id && rev->parents() == c->parents()) {
+            fh->earlyOutputCnt++;
+            return true; // filter out 'rev'
         }
+        // mismatch found! shown rows from here on are stale
+        fh->earlyOutputTail = fh->revOrder.count();
+        return false;
     }
     // we have new revisions, exit from early output state
     fh->setEarlyOutputState(false);
     return false;
 }
 
-int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
+void Git::addRevision(FileHistory* fh, Revision* rev) {
+// takes ownership of 'rev', already built and indexed by RevParser
 
     RevMap& r = fh->revs;
-    int nextStart;
-    Revision* rev;
-
-    do {
-        // only here we create a new rev
-        rev = new Revision(ba, start, fh->revOrder.count(), &nextStart, !isMainHistory(fh));
-
-        if (nextStart == -2) {
-            delete rev;
-            fh->setEarlyOutputState(true);
-            start = ba.indexOf('\n', start) + 1;
-        }
-
-    } while (nextStart == -2);
-
-    if (nextStart == -1) { // half chunk detected
-        delete rev;
-        return -1;
-    }
+    rev->orderIdx = fh->revOrder.count();
 
     const ShaString& sha = rev->sha();
+    const ObjectId id(sha);
 
     if (fh->earlyOutputCnt != -1 && filterEarlyOutputRev(fh, rev)) {
-        delete rev;
-        return nextStart;
+        fh->revArena.destroy(rev);
+        return;
     }
 
     if (isStGIT) {
         if (loadingUnAppliedPatches) { // filter out possible spurious revs
 
-            uint type = m_references.containsType(sha, Reference::UN_APPLIED);
+            uint type = m_references.containsType(id, Reference::UN_APPLIED);
             if (!type) {
-                delete rev;
-                return nextStart;
+                fh->revArena.destroy(rev);
+                return;
             }
         }
         // remove StGIT spurious revs filter
@@ -2397,22 +2963,22 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
         if (!(firstNonStGitPatch.isEmpty() && m_references.patchesStillToFind == 0) &&
             !loadingUnAppliedPatches && isMainHistory(fh)) {
 
-            uint type = m_references.containsType(sha, Reference::APPLIED);
+            uint type = m_references.containsType(id, Reference::APPLIED);
             if (!type) {
-                delete rev;
-                return nextStart;
+                fh->revArena.destroy(rev);
+                return;
             }
         }
-        if (r.contains(sha)) {
+        if (r.contains(id)) {
             // StGIT unapplied patches could be sent again by
             // 'git log' as example if called with --all option.
-            if (r[sha]->isUnApplied) {
-                delete rev;
-                return nextStart;
+            if (r[id]->isUnApplied) {
+                fh->revArena.destroy(rev);
+                return;
             }
             // could be a side effect of 'git log -m', see below
             if (isMainHistory(fh) || rev->parentsCount() < 2)
-                dbp("ASSERT: addChunk sha <%1> already received", sha);
+                dbp("ASSERT: addRevision sha <%1> already received", sha);
         }
     }
     if (r.isEmpty() && !isMainHistory(fh)) {
@@ -2425,33 +2991,38 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
 
         // this is the new rev with renamed file, the rev is correct but
         // the patch, create a new rev with proper patch and use that instead
-        const Revision* prevSha = revLookup(sha, fh);
+        const Revision* prevSha = revLookup(id, fh);
         Revision* c = fakeRevData(sha, rev->parents(), rev->author(),
                              rev->authorDate(), rev->shortLog(), rev->longLog(),
                              fh->renamedPatches[sha], prevSha->orderIdx, fh);
 
-        r.insert(sha, c); // overwrite old content
+        r.insert(id, c); // overwrite old content
+        if (c->orderIdx < fh->graph.count())
+            fh->graph.setRevision(c->orderIdx, c);
         fh->renamedPatches.remove(sha);
-        return nextStart;
+        return;
     }
-    if (!isMainHistory(fh) && rev->parentsCount() > 1 && r.contains(sha)) {
+    if (!isMainHistory(fh) && rev->parentsCount() > 1 && r.contains(id)) {
     /* In this case git log is called with -m option and merges are splitted
        in one commit per parent but all them have the same sha.
        So we add only the first to fh->revOrder to display history correctly,
        but we nevertheless add all the commits to 'r' so that annotation code
        can get the patches.
     */
-        QString mergeSha;
+        ObjectId mergeId;
         int i = 0;
         do
-            mergeSha = QString::number(++i) + " m " + sha;
-        while (r.contains(toTempSha(mergeSha)));
+            mergeId = ObjectId(id, ++i); // variant is the parent number
+        while (r.contains(mergeId));
 
-        const ShaString& ss = toPersistentSha(mergeSha, shaBackupBuf);
-        r.insert(ss, rev);
+        r.insert(mergeId, rev);
     } else {
-        r.insert(sha, rev);
-        fh->revOrder.append(sha);
+        r.insert(id, rev);
+        fh->revOrder.append(id);
+        fh->graph.append(rev);
+
+        if (isMainHistory(fh) && !loadingFromCache)
+            historyCacheNeedsUpdate = true;
 
         if (rev->parentsCount() == 0 && !isMainHistory(fh))
             fh->renamedRevs.append(sha);
@@ -2461,15 +3032,15 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
         // has been reset so update the lanes now.
         if (loadingUnAppliedPatches) {
 
-            Revision* c = const_cast<Revision*>(revLookup(sha, fh));
+            Revision* c = const_cast<Revision*>(revLookup(id, fh));
             c->isUnApplied = true;
-            c->lanes.append(LANE_UNAPPLIED);
+            c->lanes = fh->laneStore.intern(QVector<LaneType>(1, LANE_UNAPPLIED));
 
         } else if (m_references.patchesStillToFind > 0 || !isMainHistory(fh)) { // try to avoid costly lookup
 
-            uint type = m_references.containsType(sha, Reference::APPLIED);
+            uint type = m_references.containsType(id, Reference::APPLIED);
             if (type) {
-                Revision* c = const_cast<Revision*>(revLookup(sha, fh));
+                Revision* c = const_cast<Revision*>(revLookup(id, fh));
                 c->isApplied = true;
                 if (isMainHistory(fh)) {
                     m_references.patchesStillToFind--;
@@ -2481,7 +3052,6 @@ int Git::addChunk(FileHistory* fh, const QByteArray& ba, int start) {
             }
         }
     }
-    return nextStart;
 }
 
 bool Git::copyDiffIndex(FileHistory* fh, SCRef parent) {
@@ -2501,63 +3071,144 @@ bool Git::copyDiffIndex(FileHistory* fh, SCRef parent) {
 
     // insert a custom ZERO_SHA rev with proper parent
     const Revision* rf = fakeWorkDirRev(parent, "Working dir changes", "long log\n", 0, fh);
-    fh->revs.insert(ZERO_SHA_RAW, rf);
-    fh->revOrder.append(ZERO_SHA_RAW);
+    fh->revs.insert(ZERO_SHA_ID, rf);
+    fh->revOrder.append(ZERO_SHA_ID);
+    fh->graph.append(rf);
     return true;
 }
 
 void Git::setLane(SCRef sha, FileHistory* fh) {
 
+    if (laneBuilder && laneBuilder->history() == fh)
+        return; // rows not built yet are shown as placeholders
+
+    const qint64 startTime = LoadStats::now();
     Lanes* l = fh->lns;
     uint i = fh->firstFreeLane;
-    QVector<QByteArray> ba;
-    const ShaString& ss = toPersistentSha(sha, ba);
+    const ObjectId target(sha);
     const ShaVect& shaVec(fh->revOrder);
 
     for (uint cnt = shaVec.count(); i < cnt; ++i) {
 
-        const ShaString& curSha = shaVec[i];
-        Revision* r = const_cast<Revision*>(revLookup(curSha, fh));
-        if (r->lanes.count() == 0)
-            updateLanes(*r, *l, curSha);
+        if (FileHistory::isLaneMark((int)i) && isMainHistory(fh))
+            fh->laneMarks.insert(i, *l); // see FileHistory::spliceTail()
+
+        const ObjectId& curId = shaVec[i];
+        Revision* r = const_cast<Revision*>(revLookup(curId, fh));
+        if (r->lanes.count() == 0) {
+            QVector<LaneType> lanes;
+            updateLanes(*r, *l, ObjectId(r->sha()), lanes); // without variant
+            r->lanes = fh->laneStore.intern(lanes);
+        }
 
-        if (curSha == ss)
+        if (curId == target)
             break;
     }
     fh->firstFreeLane = ++i;
+
+    if (isMainHistory(fh))
+        loadStats.add(LoadStats::LANES, LoadStats::now() - startTime);
+}
+
+void Git::startLaneBuilder(FileHistory* fh) {
+// lanes of rows still without them are computed in background, meanwhile
+// setLane() does nothing, so they are all computed by the same Lanes
+
+    cancelLaneBuilder(fh);
+
+    if (fh->firstFreeLane >= (uint)fh->revOrder.count())
+        return;
+
+    laneBuilder = new LaneBuilder(this, fh, fh->graph.revisions(), *fh->lns,
+                                  fh->firstFreeLane, &fh->laneStore);
+    connect(laneBuilder, SIGNAL(lanesReady()), this, SLOT(on_lanesReady()));
+    laneBuilder->start(QThread::LowPriority);
+}
+
+void Git::cancelLaneBuilder(const FileHistory* fh) {
+// must be called before any revision of 'fh' is changed or destroyed
+
+    if (!laneBuilder || laneBuilder->history() != fh)
+        return;
+
+    laneBuilder->disconnect(this);
+    delete laneBuilder;
+    laneBuilder = NULL;
+}
+
+void Git::on_lanesReady() {
+
+    // signal could come from an already deleted builder, do not use it
+    LaneBuilder* lb = laneBuilder;
+    if (!lb || sender() != lb)
+        return;
+
+    FileHistory* fh = const_cast<FileHistory*>(lb->history());
+    QList<LaneBuilder::Chunk> chunks;
+    lb->takeChunks(chunks);
+
+    FOREACH (QList<LaneBuilder::Chunk>, it, chunks) {
+
+        const LaneBuilder::Chunk& c = *it;
+        if (c.first != (int)fh->firstFreeLane) {
+            dbs("ASSERT in on_lanesReady, lanes chunk out of order");
+            cancelLaneBuilder(fh);
+            return;
+        }
+        const int last = c.first + c.lanes.count();
+        for (int i = c.first; i < last; i++) {
+            Revision* r = const_cast<Revision*>(fh->graph.revision(i));
+            if (r->lanes.isEmpty())
+                r->lanes = c.lanes.at(i - c.first);
+        }
+        *fh->lns = c.state;
+        fh->firstFreeLane = last;
+        if (isMainHistory(fh))
+            fh->laneMarks.insert(last, c.state);
+
+        fh->lanesBuilt(c.first, last);
+
+        if (isMainHistory(fh))
+            loadStats.add(LoadStats::LANES, c.buildTime);
+    }
+    if (fh->firstFreeLane >= (uint)fh->revOrder.count())
+        cancelLaneBuilder(fh); // done, just free it
 }
 
-void Git::updateLanes(Revision& c, Lanes& lns, SCRef sha) {
-// we could get third argument from c.sha(), but we are in fast path here
-// and c.sha() involves a deep copy, so we accept a little redundancy
+void Git::updateLanes(const Revision& c, Lanes& lns, const ObjectId& id, QVector<LaneType>& lanes) {
+// lanes link ids of children and parents, so 'id' must be the plain sha
+// of 'c', without any variant of split merges. Lanes of 'c' are stored
+// in 'lanes', called also by LaneBuilder thread, so 'c' is not changed
 
     if (lns.isEmpty())
-        lns.init(sha);
+        lns.init(id);
 
     bool isDiscontinuity;
-    bool isFork = lns.isFork(sha, isDiscontinuity);
+    bool isFork = lns.isFork(id, isDiscontinuity);
     bool isMerge = (c.parentsCount() > 1);
     bool isInitial = (c.parentsCount() == 0);
 
     if (isDiscontinuity)
-        lns.changeActiveLane(sha); // uses previous isBoundary state
+        lns.changeActiveLane(id); // uses previous isBoundary state
 
     lns.setBoundary(c.isBoundary()); // update must be here
 
     if (isFork)
-        lns.setFork(sha);
-    if (isMerge)
-        lns.setMerge(c.parents());
+        lns.setFork(id);
+    if (isMerge) {
+        QVector<ObjectId> parents(c.parentsCount());
+        for (int i = 0; i < parents.count(); i++)
+            parents[i] = c.parent(i);
+        lns.setMerge(parents);
+    }
     if (c.isApplied)
         lns.setApplied();
     if (isInitial)
         lns.setInitial();
 
-    lns.getLanes(c.lanes); // here lanes are snapshotted
-
-    SCRef nextSha = (isInitial) ? "" : QString(c.parent(0));
+    lns.getLanes(lanes); // here lanes are snapshotted
 
-    lns.nextParent(nextSha);
+    lns.nextParent(isInitial ? ObjectId() : ObjectId(c.parent(0)));
 
     if (c.isApplied)
         lns.afterApplied();
@@ -2573,7 +3224,7 @@ void Git::updateLanes(Revision& c, Lanes& lns, SCRef sha) {
 //    	tmp2.setNum(c.lanes[i]);
 //    	tmp.append(tmp2 + "-");
 //    }
-//    qDebug("%s %s", tmp.toUtf8().data(), sha.toUtf8().data());
+//    qDebug("%s %s", tmp.toUtf8().data(), id.toString().toUtf8().data());
 }
 
 void Git::procFinished() {
@@ -2591,8 +3242,8 @@ void Git::procReadyRead(const QByteArray& fileChunk) {
         filesLoadingPending.append(fileChunk); // add to previous half lines
 
     RevFile* rf = NULL;
-    if (!filesLoadingCurSha.isEmpty() && revsFiles.contains(toTempSha(filesLoadingCurSha)))
-        rf = const_cast<RevFile*>(revsFiles[toTempSha(filesLoadingCurSha)]);
+    if (!filesLoadingCurSha.isEmpty() && revsFiles.contains(ObjectId(filesLoadingCurSha)))
+        rf = const_cast<RevFile*>(revsFiles[ObjectId(filesLoadingCurSha)]);
 
     int nextEOL = filesLoadingPending.indexOf('\n');
     int lastEOL = -1;
@@ -2603,7 +3254,7 @@ void Git::procReadyRead(const QByteArray& fileChunk) {
             SCRef sha = line.left(40);
             if (!rf || sha != filesLoadingCurSha) { // new commit
                 rf = new RevFile();
-                revsFiles.insert(toPersistentSha(sha, revsFilesShaBackupBuf), rf);
+                revsFiles.insert(ObjectId(sha), rf);
                 filesLoadingCurSha = sha;
                 cacheNeedsUpdate = true;
             } else
@@ -2672,196 +3323,82 @@ void Git::appendFileName(RevFile& rf, SCRef name, FileNamesLoader& fl) {
         fl.rfNames.append(*it);
 }
 
-void Git::updateDescMap(const Revision* r,uint idx, QHash<QPair<uint, uint>, bool>& dm,
-                        QHash<uint, QVector<int> >& dv) {
-
-    QVector<int> descVec;
-    if (r->descRefsMaster != -1) {
-
-        const Revision* tmp = revLookup(revData->revOrder[r->descRefsMaster]);
-        const QVector<int>& nr = tmp->descRefs;
-
-        for (int i = 0; i < nr.count(); i++) {
-
-            if (!dv.contains(nr[i])) {
-                dbp("ASSERT descendant for %1 not found", r->sha());
-                return;
-            }
-            const QVector<int>& dvv = dv[nr[i]];
+void Git::indexTree() {
+// starts indexing of nearest tags, descendant branches and of reachability
+// in background,
+// results are published by on_treeIndexed()
 
-            // copy the whole vector instead of each element
-            // in the first iteration of the loop below
-            descVec = dvv; // quick (shared) copy
+    cancelIndexTree();
 
-            for (int y = 0; y < dvv.count(); y++) {
+    const ShaVect& ro = revData->revOrder;
+    if (ro.count() == 0)
+        return;
 
-                uint v = (uint)dvv[y];
-                QPair<uint, uint> key = qMakePair(idx, v);
-                QPair<uint, uint> keyN = qMakePair(v, idx);
-                dm.insert(key, true);
-                dm.insert(keyN, false);
+    // refs are looked up here, worker thread sees only a snapshot
+    QVector<uchar> refTypes(ro.count(), 0);
+    for (int i = 0, cnt = ro.count(); i < cnt; i++) {
 
-                // we don't want duplicated entry, otherwise 'dvv' grows
-                // greatly in repos with many tagged development branches
-                if (i > 0 && !descVec.contains(v)) // i > 0 is rare, no
-                    descVec.append(v);         // need to optimize
-            }
-        }
+        uint type = m_references.containsType(ro[i]);
+        if (type & (Reference::BRANCH | Reference::REMOTE_BRANCH))
+            refTypes[i] |= TreeIndexer::BRANCH;
+        if (type & Reference::TAG)
+            refTypes[i] |= TreeIndexer::TAG;
     }
-    descVec.append(idx);
-    dv.insert(idx, descVec);
+    treeIndexer = new TreeIndexer(this, revData->graph.links(), refTypes);
+    connect(treeIndexer, SIGNAL(finished()), this, SLOT(on_treeIndexed()));
+    treeIndexer->start(QThread::LowPriority);
 }
 
-void Git::mergeBranches(Revision* p, const Revision* r) {
-
-    int r_descBrnMaster = (m_references.containsType(r->sha(), Reference::BRANCH | Reference::REMOTE_BRANCH) ? r->orderIdx : r->descBrnMaster);
+void Git::cancelIndexTree() {
+// must be called before revisions are changed, a canceled
+// worker is waited for, but is quick to stop
 
-    if (p->descBrnMaster == r_descBrnMaster || r_descBrnMaster == -1)
+    if (!treeIndexer)
         return;
 
-    // we want all the descendant branches, so just avoid duplicates
-    const QVector<int>& src1 = revLookup(revData->revOrder[p->descBrnMaster])->descBranches;
-    const QVector<int>& src2 = revLookup(revData->revOrder[r_descBrnMaster])->descBranches;
-    QVector<int> dst(src1);
-    for (int i = 0; i < src2.count(); i++)
-        if (qFind(src1.constBegin(), src1.constEnd(), src2[i]) == src1.constEnd())
-            dst.append(src2[i]);
-
-    p->descBranches = dst;
-    p->descBrnMaster = p->orderIdx;
+    treeIndexer->disconnect(this);
+    delete treeIndexer;
+    treeIndexer = NULL;
 }
 
-void Git::mergeNearTags(bool down, Revision* p, const Revision* r, const QHash<QPair<uint, uint>, bool>& dm) {
+void Git::on_treeIndexed() {
 
-    bool isTag = m_references.containsType(r->sha(), Reference::TAG);
-    int r_descRefsMaster = isTag ? r->orderIdx : r->descRefsMaster;
-    int r_ancRefsMaster = isTag ? r->orderIdx : r->ancRefsMaster;
-
-    if (down && (p->descRefsMaster == r_descRefsMaster || r_descRefsMaster == -1))
+    // signal could come from an already deleted worker, do not use it
+    TreeIndexer* ti = treeIndexer;
+    if (!ti || sender() != ti)
         return;
 
-    if (!down && (p->ancRefsMaster == r_ancRefsMaster || r_ancRefsMaster == -1))
+    // with Qt < 4.8 finished() is sent before isFinished() is true, so
+    // wait for run() to be really over, it is a matter of an instant
+    ti->wait();
+    if (ti->isCanceled())
         return;
 
-    // we want the nearest tag only, so remove any tag
-    // that is ancestor of any other tag in p U r
-    const ShaVect& ro = revData->revOrder;
-    const ShaString& sha1 = down ? ro[p->descRefsMaster] : ro[p->ancRefsMaster];
-    const ShaString& sha2 = down ? ro[r_descRefsMaster] : ro[r_ancRefsMaster];
-    const QVector<int>& src1 = down ? revLookup(sha1)->descRefs : revLookup(sha1)->ancRefs;
-    const QVector<int>& src2 = down ? revLookup(sha2)->descRefs : revLookup(sha2)->ancRefs;
-    QVector<int> dst(src1);
-
-    for (int s2 = 0; s2 < src2.count(); s2++) {
+    const qint64 startTime = LoadStats::now();
+    const TreeIndexer::Result& res = ti->result();
+    const RevGraph& g = revData->graph;
 
-        bool add = false;
-        for (int s1 = 0; s1 < src1.count(); s1++) {
-
-            if (src2[s2] == src1[s1]) {
-                add = false;
-                break;
-            }
-            QPair<uint, uint> key = qMakePair((uint)src2[s2], (uint)src1[s1]);
-
-            if (!dm.contains(key)) { // could be empty if all tags are independent
-                add = true; // could be an independent path
-                continue;
-            }
-            add = (down && dm[key]) || (!down && !dm[key]);
-            if (add)
-                dst[s1] = -1; // mark for removing
-            else
-                break;
-        }
-        if (add)
-            dst.append(src2[s2]);
-    }
-    QVector<int>& nearRefs = (down ? p->descRefs : p->ancRefs);
-    int& nearRefsMaster = (down ? p->descRefsMaster : p->ancRefsMaster);
-
-    nearRefs.clear();
-    for (int s2 = 0; s2 < dst.count(); s2++)
-        if (dst[s2] != -1)
-            nearRefs.append(dst[s2]);
-
-    nearRefsMaster = p->orderIdx;
-}
-
-void Git::indexTree() {
-
-    const ShaVect& ro = revData->revOrder;
-    if (ro.count() == 0)
+    if (res.descRefsMaster.count() != g.count()) {
+        dbs("ASSERT in on_treeIndexed, history changed while indexing");
+        cancelIndexTree();
         return;
-
-    // we keep the pairs(x, y). Value is true if x is
-    // ancestor of y or false if y is ancestor of x
-    QHash<QPair<uint, uint>, bool> descMap;
-    QHash<uint, QVector<int> > descVect;
-
-    // walk down the tree from latest to oldest,
-    // compute children and nearest descendants
-    for (uint i = 0, cnt = ro.count(); i < cnt; i++) {
-
-        uint type = m_references.containsType(ro[i]);
-        bool isB = (type & (Reference::BRANCH | Reference::REMOTE_BRANCH));
-        bool isT = (type & Reference::TAG);
-
-        const Revision* r = revLookup(ro[i]);
-
-        if (isB) {
-            Revision* rr = const_cast<Revision*>(r);
-            if (r->descBrnMaster != -1) {
-                const ShaString& sha = ro[r->descBrnMaster];
-                rr->descBranches = revLookup(sha)->descBranches;
-            }
-            rr->descBranches.append(i);
-        }
-        if (isT) {
-            updateDescMap(r, i, descMap, descVect);
-            Revision* rr = const_cast<Revision*>(r);
-            rr->descRefs.clear();
-            rr->descRefs.append(i);
-        }
-        for (uint y = 0; y < r->parentsCount(); y++) {
-
-            Revision* p = const_cast<Revision*>(revLookup(r->parent(y)));
-            if (p) {
-                p->childs.append(i);
-
-                if (p->descBrnMaster == -1)
-                    p->descBrnMaster = isB ? r->orderIdx : r->descBrnMaster;
-                else
-                    mergeBranches(p, r);
-
-                if (p->descRefsMaster == -1)
-                    p->descRefsMaster = isT ? r->orderIdx : r->descRefsMaster;
-                else
-                    mergeNearTags(optGoDown, p, r, descMap);
-            }
-        }
-    }
-    // walk backward through the tree and compute nearest tagged ancestors
-    for (int i = ro.count() - 1; i >= 0; i--) {
-
-        const Revision* r = revLookup(ro[i]);
-        bool isTag = m_references.containsType(ro[i], Reference::TAG);
-
-        if (isTag) {
-            Revision* rr = const_cast<Revision*>(r);
-            rr->ancRefs.clear();
-            rr->ancRefs.append(i);
-        }
-        for (int y = 0; y < r->childs.count(); y++) {
-
-            Revision* c = const_cast<Revision*>(revLookup(ro[r->childs[y]]));
-            if (c) {
-                if (c->ancRefsMaster == -1)
-                    c->ancRefsMaster = isTag ? r->orderIdx:r->ancRefsMaster;
-                else
-                    mergeNearTags(!optGoDown, c, r, descMap);
-            }
-        }
     }
+    // all at once, views never see a partially indexed history
+    for (int i = 0, cnt = g.count(); i < cnt; i++) {
+
+        Revision* r = const_cast<Revision*>(g.revision(i));
+        r->descRefsMaster = res.descRefsMaster.at(i);
+        r->ancRefsMaster = res.ancRefsMaster.at(i);
+        r->descBrnMaster = res.descBrnMaster.at(i);
+        r->descRefs = res.descRefs.value(i);
+        r->ancRefs = res.ancRefs.value(i);
+        r->descBranches = res.descBranches.value(i);
+    }
+    revData->reach = res.reach;
+    loadStats.add(LoadStats::INDEX_TREE, res.indexTime + LoadStats::now() - startTime);
+    cancelIndexTree(); // done, just free it
+    emit treeIndexed();
+    emit loadStatsChanged();
 }
 
 
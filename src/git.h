@@ -8,9 +8,12 @@
 #define GIT_H
 
 #include <QAbstractItemModel>
+#include <QCache>
+#include <QPointer>
 #include "exceptionmanager.h"
 #include "common.h"
 #include "domain.h"
+#include "loadstats.h"
 #include "model/revision.h"
 #include "model/reference.h"
 #include "model/tagreference.h"
@@ -25,10 +28,14 @@ class QRegExp;
 class QTextCodec;
 class Annotate;
 class Cache;
+class CatFileBatch;
 class DataLoader;
 class Domain;
 class Git;
+class LaneBuilder;
+class NativeLoader;
 class Lanes;
+class TreeIndexer;
 class MyProcess;
 class FileHistory;
 
@@ -71,6 +78,7 @@ public:
     const QStringList getGitConfigList(bool global);
     const QString getBaseDir(bool* c, SCRef wd, bool* ok = NULL, QString* gd = NULL);
     bool init(SCRef wd, bool range, const QStringList* args, bool overwrite, bool* quit);
+    bool refreshIncrementally();
     void stop(bool saveCache);
     void setThrowOnStop(bool b);
     bool isThrowOnStopRaised(int excpId, SCRef curContext);
@@ -80,6 +88,7 @@ public:
     void cancelAnnotate(Annotate* ann);
     bool startFileHistory(SCRef sha, SCRef startingFileName, FileHistory* fh);
     void cancelDataLoading(const FileHistory* fh);
+    void cancelLaneBuilder(const FileHistory* fh);
     void cancelProcess(MyProcess* p);
     bool isCommittingMerge() const { return isMergeHead; }
     bool isStGITStack() const { return isStGIT; }
@@ -90,6 +99,8 @@ public:
     bool isUnknownFiles() const { return (workingDirInfo.otherFiles.count() > 0); }
     bool isTextHighlighter() const { return isTextHighlighterFound; }
     bool isMainHistory(const FileHistory* fh) { return (fh == revData); }
+    LoadStats* getLoadStats(const FileHistory* fh) { return (isMainHistory(fh) ? &loadStats : NULL); }
+    const LoadStats& getLoadStats() const { return loadStats; }
     MyProcess* getDiff(SCRef sha, QObject* receiver, SCRef diffToSha, bool combined);
     const QString getWorkDirDiff(SCRef fileName = "");
     MyProcess* getFile(SCRef fileSha, QObject* receiver, QByteArray* result, SCRef fileName);
@@ -103,15 +114,19 @@ public:
     static const QString getLocalDate(SCRef gitDate);
     const QString getDesc(SCRef sha, QRegExp& slogRE, QRegExp& lLogRE, bool showH, FileHistory* fh);
     const QString getLastCommitMsg();
+    const QString getLongLog(const Revision* r);
+    bool grepLongLogs(const FileHistory* fh, SCRef wildcard, ShaSet& shas);
     const QString getNewCommitMsg();
     const QString getLaneParent(SCRef fromSHA, int laneNum);
     const QStringList getChilds(SCRef parent);
     const QStringList getNearTags(bool goDown, SCRef sha);
     const QStringList getDescendantBranches(SCRef sha, bool shaOnly = false);
+    bool isAncestor(SCRef anc, SCRef sha, bool* known = NULL);
     const QString getShortLog(SCRef sha);
+    const Revision* revLookup(const ObjectId& id, const FileHistory* fh = NULL) const;
     const Revision* revLookup(const ShaString& sha, const FileHistory* fh = NULL) const;
     const Revision* revLookup(SCRef sha, const FileHistory* fh = NULL) const;
-    const QString getRevInfo(const ShaString &sha);
+    const QString getRevInfo(const ObjectId& sha);
     const QStringList getAllRefNames(uint mask, bool onlyLoaded);
     const QStringList sortShaListByIndex(SCList shaList);
     void getWorkDirFiles(SList files, SList dirs, RevFile::StatusFlag status);
@@ -153,13 +168,15 @@ public:
     }
 
 signals:
-    void newRevsAdded(const FileHistory*, const QVector<ShaString>&);
+    void newRevsAdded(const FileHistory*, const QVector<ObjectId>&);
     void loadCompleted(const FileHistory*, const QString&);
     void cancelLoading(const FileHistory*);
     void cancelAllProcesses();
     void annotateReady(Annotate*, bool, const QString&);
     void fileNamesLoad(int, int);
     void changeFont(const QFont&);
+    void loadStatsChanged();
+    void treeIndexed();
 
 public slots:
     void procReadyRead(const QByteArray&);
@@ -172,10 +189,17 @@ private slots:
     void on_getHighlightedFile_eof();
     void on_newDataReady(const FileHistory*);
     void on_loaded(FileHistory*, ulong,int,bool,const QString&,const QString&);
+    void on_shardsListed(int revsCnt);
+    void on_nativeDataReady();
+    void fallBackOnGitLog();
+    void on_treeIndexed();
+    void on_lanesReady();
 
 private:
     friend class MainImpl;
     friend class DataLoader;
+    friend class LaneBuilder;
+    friend class FileHistory;
     friend class ConsoleImpl;
     friend class RevsView;
 
@@ -218,32 +242,43 @@ private:
     bool getRefs();
     void clearRevs();
     void clearFileNames();
-    bool startRevList(SCList args, FileHistory* fh);
+    const QStringList getLogCmd(const FileHistory* fh);
+    bool startRevList(SCList args, FileHistory* fh, bool boundary = true);
     bool startUnappliedList();
     bool startParseProc(SCList initCmd, FileHistory* fh, SCRef buf);
+    DataLoader* createDataLoader(FileHistory* fh);
+    bool getPlainRefsArgs(QStringList& args) const;
+    int countRevs();
+    void reserveRevs(int cnt);
+    bool areReachable(SCList heads, SCList args);
+    bool startCachedRevList();
+    bool startNativeRevList();
+    void cancelNativeLoader();
+    bool startShardedRevList();
+    bool startNewRevList(SCList args, SCList heads, SCRef msg);
+    void loadNewRevisions();
     bool tryFollowRenames(FileHistory* fh);
     bool populateRenamedPatches(SCRef sha, SCList nn, FileHistory* fh, QStringList* on, bool bt);
     bool filterEarlyOutputRev(FileHistory* fh, Revision* rev);
-    int addChunk(FileHistory* fh, const QByteArray& ba, int ofs);
+    void addRevision(FileHistory* fh, Revision* rev);
     void parseDiffFormat(RevFile& rf, SCRef buf, FileNamesLoader& fl);
     void parseDiffFormatLine(RevFile& rf, SCRef line, int parNum, FileNamesLoader& fl);
     void getDiffIndex();
+    const QStringList getHistoryHeads() const;
     Revision* fakeRevData(SCRef sha, SCList parents, SCRef author, SCRef date, SCRef log,
                          SCRef longLog, SCRef patch, int idx, FileHistory* fh);
     const Revision* fakeWorkDirRev(SCRef parent, SCRef log, SCRef longLog, int idx, FileHistory* fh);
     const RevFile* fakeWorkDirRevFile(const WorkingDirInfo& wd);
     bool copyDiffIndex(FileHistory* fh, SCRef parent);
-    const RevFile* insertNewFiles(SCRef sha, SCRef data);
+    const RevFile* insertNewFiles(const ObjectId& id, SCRef data);
     const RevFile* getAllMergeFiles(const Revision* r);
     bool runDiffTreeWithRenameDetection(SCRef runCmd, QString* runOutput);
     bool isParentOf(SCRef par, SCRef child);
     bool isTreeModified(SCRef sha);
     void indexTree();
-    void updateDescMap(const Revision* r, uint i, QHash<QPair<uint, uint>,bool>& dm,
-                       QHash<uint, QVector<int> >& dv);
-    void mergeNearTags(bool down, Revision* p, const Revision* r, const QHash<QPair<uint, uint>, bool>&dm);
-    void mergeBranches(Revision* p, const Revision* r);
-    void updateLanes(Revision& c, Lanes& lns, SCRef sha);
+    void cancelIndexTree();
+    static void updateLanes(const Revision& c, Lanes& lns, const ObjectId& id, QVector<LaneType>& lanes);
+    void startLaneBuilder(FileHistory* fh);
     bool mkPatchFromWorkDir(SCRef msg, SCRef patchFile, SCList files);
     const QStringList getOthersFiles();
     const QStringList getOtherFiles(SCList selFiles, bool onlyInIndex);
@@ -276,11 +311,22 @@ private:
     bool isTextHighlighterFound;
     bool loadingUnAppliedPatches;
     bool fileCacheAccessed;
+    bool mainHistoryLoaded;
+    int refreshTailRow;              // first new row while refreshing, or -1
+    const Revision* oldWorkDirRev;   // replaced by refresh, still shown
+    bool loadingFromCache;           // or from native reader, see init2()
+    bool historyCacheNeedsUpdate;
+    QStringList cachedHeads;         // heads of history cache being loaded
+    CatFileBatch* catFile;           // log messages on demand, see getLongLog()
+    QCache<ObjectId, QString> longLogCache;
+    TreeIndexer* treeIndexer;        // refs indexing in background, see indexTree()
+    LaneBuilder* laneBuilder;        // main history lanes in background
+    NativeLoader* nativeLoader;      // main history read in background
+    QPointer<DataLoader> nativeFeed; // loads what nativeLoader reads
+    LoadStats loadStats;             // of main history, see getLoadStats()
     QString firstNonStGitPatch;
     RevFileMap revsFiles;
-    QVector<QByteArray> revsFilesShaBackupBuf;
     // TODO: move to References
-    QVector<QByteArray> shaBackupBuf;
     StrVect fileNamesVec;
     StrVect dirNamesVec;
     QHash<QString, int> fileNamesMap; // quick lookup file name
@@ -0,0 +1,98 @@
+#include <ctype.h>
+#include <QStringList>
+
+#include "catfilebatch.h"
+#include "common.h"
+
+bool CatFileBatch::start()
+{
+    proc.setWorkingDirectory(wd);
+    return QGit::startProcess(&proc, QStringList() << "git" << "cat-file" << "--batch");
+}
+
+void CatFileBatch::stop()
+{
+    if (proc.state() == QProcess::NotRunning)
+        return;
+
+    proc.closeWriteChannel(); // process exits at end of input
+    if (!proc.waitForFinished(TIMEOUT))
+        proc.kill();
+}
+
+bool CatFileBatch::waitFor(qint64 bytes)
+{
+    // 'bytes' < 0 waits for a whole line
+    while (bytes < 0 ? !proc.canReadLine() : proc.bytesAvailable() < bytes)
+        if (!proc.waitForReadyRead(TIMEOUT))
+            return false;
+
+    return true;
+}
+
+bool CatFileBatch::read(const QString& sha, QByteArray& data)
+{
+    if (proc.state() != QProcess::Running && !start())
+        return false;
+
+    // answer is "<sha> <type> <size>\n<content>\n" or "<sha> missing\n"
+    proc.write(sha.toLatin1() + '\n');
+    if (!waitFor(-1)) {
+        dbs("ASSERT in CatFileBatch::read, no answer from git cat-file");
+        stop();
+        return false;
+    }
+    const QList<QByteArray> header(proc.readLine().trimmed().split(' '));
+    if (header.count() != 3)
+        return false;
+
+    bool ok;
+    const int size = header.at(2).toInt(&ok);
+    if (!ok || !waitFor(size + 1)) {
+        dbs("ASSERT in CatFileBatch::read, unexpected answer from git cat-file");
+        stop();
+        return false;
+    }
+    data = proc.read(size);
+    proc.read(1); // trailing '\n'
+    return true;
+}
+
+static bool isBlankLine(const char* data, int from, int to)
+{
+    for (int i = from; i < to; i++)
+        if (!isspace((uchar)data[i]))
+            return false;
+    return true;
+}
+
+const QByteArray CatFileBatch::commitBody(const QByteArray& commit)
+{
+/*
+   Headers end at first blank line, then there is the subject paragraph,
+   that git log shows as %s, some blank lines and finally the body.
+*/
+    int idx = commit.indexOf("\n\n");
+    if (idx == -1)
+        return QByteArray();
+
+    const char* data = commit.constData();
+    const int size = commit.size();
+    bool subjectFound = false, inSubject = false;
+
+    for (idx += 2; idx < size; ) {
+        int end = commit.indexOf('\n', idx);
+        end = (end == -1 ? size : end);
+
+        const bool isBlank = isBlankLine(data, idx, end);
+        if (isBlank)
+            inSubject = false;
+        else if (!subjectFound)
+            subjectFound = inSubject = true;
+        else if (!inSubject) // first line after subject and blank lines
+            return '\n' + commit.mid(idx); // as Revision::longLog()
+
+        idx = end + 1;
+    }
+    return QByteArray();
+}
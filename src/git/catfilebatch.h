@@ -0,0 +1,44 @@
+#ifndef CATFILEBATCH_H
+#define CATFILEBATCH_H
+
+#include <QByteArray>
+#include <QProcess>
+#include <QString>
+
+//! Synchronous reader of git objects through 'git cat-file --batch'
+/*!
+  One long running process answers all requests, so that reading an
+  object costs a round trip on a pipe instead of a new git process.
+  Process is started at first request and restarted after an error.
+*/
+class CatFileBatch
+{
+public:
+    explicit CatFileBatch(const QString& workDir) : wd(workDir) {}
+    ~CatFileBatch() { stop(); }
+
+    /*!
+      Reads content of object \a sha in \a data.
+      \return false if object is missing or process does not answer.
+    */
+    bool read(const QString& sha, QByteArray& data);
+    void stop();
+
+    //! Log message body of a raw commit object, as Revision::longLog()
+    static const QByteArray commitBody(const QByteArray& commit);
+
+private:
+    // prevent implicit C++ compiler defaults
+    CatFileBatch(const CatFileBatch&);
+    CatFileBatch& operator=(const CatFileBatch&);
+
+    enum { TIMEOUT = 5000 }; // ms
+
+    bool start();
+    bool waitFor(qint64 bytes);
+
+    QProcess proc;
+    const QString wd;
+};
+
+#endif // CATFILEBATCH_H
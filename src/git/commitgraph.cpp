@@ -0,0 +1,144 @@
+#include <QFile>
+#include <QtEndian>
+
+#include "commitgraph.h"
+
+static inline quint32 be32(const uchar* p)
+{
+    return qFromBigEndian<quint32>(p);
+}
+
+CommitGraph::CommitGraph(const QString& objectsDir) :
+    file(NULL), oidf(NULL), oidl(NULL), cdat(NULL), edge(NULL), edgeCnt(0), cnt(0)
+{
+/*
+   Layout is a 8 bytes header, "CGPH", version, hash version, number of
+   chunks and of base graphs, then a table of (chunk id, 64 bit offset)
+   entries terminated by an entry with a null id and the end offset.
+*/
+    file = new QFile(objectsDir + "/info/commit-graph");
+    if (!file->open(QIODevice::ReadOnly))
+        return;
+
+    const qint64 size = file->size();
+    const uchar* data = (size > 8 ? file->map(0, size) : NULL);
+    if (!data || memcmp(data, "CGPH", 4) || data[4] != 1 || data[5] != 1 || data[7] != 0)
+        return;
+
+    const int chunksCnt = data[6];
+    if (8 + (chunksCnt + 1) * 12 > size)
+        return;
+
+    qint64 oidlSize = 0, cdatSize = 0, edgeSize = 0;
+    for (int i = 0; i < chunksCnt; i++) {
+
+        const uchar* c = data + 8 + i * 12;
+        const qint64 ofs = ((qint64)be32(c + 4) << 32) | be32(c + 8);
+        const qint64 next = ((qint64)be32(c + 16) << 32) | be32(c + 20);
+        if (ofs < 0 || next < ofs || next > size)
+            return;
+
+        switch (be32(c)) {
+        case 0x4F494446: // "OIDF"
+            if (next - ofs >= 256 * 4)
+                oidf = data + ofs;
+            break;
+        case 0x4F49444C: // "OIDL"
+            oidl = data + ofs;
+            oidlSize = next - ofs;
+            break;
+        case 0x43444154: // "CDAT"
+            cdat = data + ofs;
+            cdatSize = next - ofs;
+            break;
+        case 0x45444745: // "EDGE"
+            edge = data + ofs;
+            edgeSize = next - ofs;
+            break;
+        default: // other chunks are not needed
+            break;
+        }
+    }
+    if (!oidf || !oidl || !cdat)
+        return;
+
+    const qint64 n = be32(oidf + 255 * 4);
+    if (n <= 0 || n > 0x70000000 || oidlSize < n * 20 || cdatSize < n * CDAT_ENTRY_SIZE)
+        return;
+
+    edgeCnt = (int)(edgeSize / 4);
+    cnt = (int)n;
+}
+
+CommitGraph::~CommitGraph()
+{
+    delete file; // releases the mapping
+}
+
+int CommitGraph::position(const ObjectId& id) const
+{
+    if (!cnt)
+        return -1;
+
+    const uchar* key = id.raw();
+    int lo = (key[0] ? (int)be32(oidf + (key[0] - 1) * 4) : 0);
+    int hi = (int)be32(oidf + key[0] * 4);
+
+    while (lo < hi) {
+        const int mid = lo + (hi - lo) / 2;
+        const int cmp = memcmp(oidl + mid * 20, key, 20);
+        if (cmp == 0)
+            return mid;
+
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+qint64 CommitGraph::commitTime(int pos) const
+{
+    // 34 bits, the lowest 2 bits of the generation word are the highest ones
+    const uchar* d = cdat + pos * CDAT_ENTRY_SIZE + 28;
+    return ((qint64)(be32(d) & 3) << 32) | be32(d + 4);
+}
+
+bool CommitGraph::parents(int pos, QVector<int>& parents) const
+{
+    const uchar* d = cdat + pos * CDAT_ENTRY_SIZE + 20;
+    const quint32 p1 = be32(d);
+    const quint32 p2 = be32(d + 4);
+
+    if (p1 == NO_PARENT)
+        return true;
+
+    if (p1 >= (quint32)cnt)
+        return false;
+
+    parents.append((int)p1);
+    if (p2 == NO_PARENT)
+        return true;
+
+    if (!(p2 & EDGE_LAST)) { // just two parents
+        if (p2 >= (quint32)cnt)
+            return false;
+
+        parents.append((int)p2);
+        return true;
+    }
+    // octopus merge, parents from the second on are in EDGE chunk
+    for (int i = (int)(p2 & ~EDGE_LAST); i < edgeCnt; i++) {
+
+        const quint32 e = be32(edge + i * 4);
+        const quint32 p = e & ~EDGE_LAST;
+        if (p >= (quint32)cnt)
+            return false;
+
+        parents.append((int)p);
+        if (e & EDGE_LAST)
+            return true;
+    }
+    return false;
+}
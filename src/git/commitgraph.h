@@ -0,0 +1,57 @@
+#ifndef COMMITGRAPH_H
+#define COMMITGRAPH_H
+
+#include <QString>
+#include <QVector>
+
+#include "model/objectid.h"
+
+class QFile;
+
+//! Reader of git commit-graph file
+/*!
+  The file ".git/objects/info/commit-graph", written by 'git gc' or
+  'git commit-graph write', stores ids, parents and commit dates of the
+  commits in a packed binary form. Commits are addressed by position,
+  the index of their id in the sorted id table.
+
+  Only a single file is supported, a split chain of graph files is
+  considered not valid.
+*/
+class CommitGraph
+{
+public:
+    explicit CommitGraph(const QString& objectsDir);
+    ~CommitGraph();
+    bool isValid() const { return cnt > 0; }
+    int count() const { return cnt; }
+
+    //! \return position of \a id or -1 if not in the graph
+    int position(const ObjectId& id) const;
+
+    ObjectId id(int pos) const { return ObjectId::fromRaw(oidl + pos * 20); }
+    qint64 commitTime(int pos) const;
+
+    //! Appends parents positions of \a pos to \a parents
+    bool parents(int pos, QVector<int>& parents) const;
+
+private:
+    // prevent implicit C++ compiler defaults
+    CommitGraph(const CommitGraph&);
+    CommitGraph& operator=(const CommitGraph&);
+
+    static const quint32 NO_PARENT = 0x70000000;
+    static const quint32 EDGE_LAST = 0x80000000;
+
+    enum { CDAT_ENTRY_SIZE = 36 }; // tree id, 2 parents, generation and date
+
+    QFile* file;
+    const uchar* oidf; // fan-out table
+    const uchar* oidl; // sorted ids
+    const uchar* cdat; // commit data
+    const uchar* edge; // extra parents of octopus merges
+    int edgeCnt;
+    int cnt;
+};
+
+#endif // COMMITGRAPH_H
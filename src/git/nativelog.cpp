@@ -0,0 +1,374 @@
+#include <ctype.h>
+#include <QDir>
+#include <QFile>
+#include <QPair>
+#include <QtAlgorithms>
+
+#include "nativelog.h"
+#include "common.h"
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static void appendHex(QByteArray& out, const ObjectId& id)
+{
+    char buf[40];
+    const uchar* raw = id.raw();
+    for (int i = 0; i < 20; i++) {
+        buf[2 * i] = hexDigits[raw[i] >> 4];
+        buf[2 * i + 1] = hexDigits[raw[i] & 15];
+    }
+    out.append(buf, 40);
+}
+
+static int lineEnd(const QByteArray& ba, int from, int to)
+{
+    const int idx = ba.indexOf('\n', from);
+    return (idx == -1 || idx > to ? to : idx);
+}
+
+static int trimmedEnd(const char* data, int from, int to)
+{
+    while (to > from && isspace((uchar)data[to - 1]))
+        to--;
+    return to;
+}
+
+static void appendPerson(QByteArray& out, const QByteArray& obj, int from, int to, QByteArray* date)
+{
+    // "Name <email> 1234567890 +0100" -> "Name<email>"
+    const int lt = obj.indexOf('<', from);
+    const int gt = (lt != -1 ? obj.indexOf('>', lt) : -1);
+    if (gt == -1 || gt > to) {
+        out.append(obj.constData() + from, to - from);
+        return;
+    }
+    out.append(obj.constData() + from, trimmedEnd(obj.constData(), from, lt) - from);
+    out.append(obj.constData() + lt, gt + 1 - lt);
+
+    if (date) {
+        int i = gt + 1;
+        while (i < to && obj.at(i) == ' ')
+            i++;
+        int end = i;
+        while (end < to && obj.at(end) >= '0' && obj.at(end) <= '9')
+            end++;
+        *date = obj.mid(i, end - i);
+    }
+}
+
+NativeLog::NativeLog(const QString& gitDir) :
+    graph(objectsDir(gitDir)), store(objectsDir(gitDir)), withBody(true)
+{
+    graphNodes.fill(-1, graph.count());
+}
+
+const QString NativeLog::commonDir(const QString& gitDir)
+{
+    // a linked working tree shares the objects and refs of the main repository
+    QFile f(gitDir + "/commondir");
+    if (!f.open(QIODevice::ReadOnly))
+        return gitDir;
+
+    const QString common(QString::fromLocal8Bit(f.readAll()).trimmed());
+    return QDir(gitDir).absoluteFilePath(common);
+}
+
+const QString NativeLog::objectsDir(const QString& gitDir)
+{
+    return commonDir(gitDir) + "/objects";
+}
+
+bool NativeLog::isSupported(const QString& gitDir)
+{
+    // git log follows replace refs and grafts and stops at shallow
+    // commits, parents read here from the objects would differ
+    const QString common(commonDir(gitDir));
+    if (QFile::exists(common + "/info/grafts") || QFile::exists(common + "/shallow"))
+        return false;
+
+    const QDir replaceDir(common + "/refs/replace");
+    if (replaceDir.exists() && !replaceDir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot).isEmpty())
+        return false;
+
+    QFile packed(common + "/packed-refs");
+    if (packed.open(QIODevice::ReadOnly))
+        while (!packed.atEnd())
+            if (packed.readLine().contains(" refs/replace/"))
+                return false;
+
+    return true;
+}
+
+int NativeLog::graphNode(int pos)
+{
+    int n = graphNodes.at(pos);
+    if (n == -1) {
+        n = ids.count();
+        graphNodes[pos] = n;
+        ids.append(graph.id(pos));
+        graphPos.append(pos);
+        parentOfs.append(-1);
+        parentCnt.append(0);
+    }
+    return n;
+}
+
+int NativeLog::node(const ObjectId& id)
+{
+    const int pos = graph.position(id);
+    if (pos != -1)
+        return graphNode(pos);
+
+    QHash<ObjectId, int>::const_iterator it(extraNodes.constFind(id));
+    if (it != extraNodes.constEnd())
+        return it.value();
+
+    const int n = ids.count();
+    extraNodes.insert(id, n);
+    ids.append(id);
+    graphPos.append(-1);
+    parentOfs.append(-1);
+    parentCnt.append(0);
+    return n;
+}
+
+bool NativeLog::expand(int n)
+{
+    // sets parents of node 'n', from commit-graph or from commit object
+    QVector<int> tmp;
+    if (graphPos.at(n) != -1) {
+        if (!graph.parents(graphPos.at(n), tmp))
+            return false;
+
+        for (int i = 0; i < tmp.count(); i++)
+            tmp[i] = graphNode(tmp.at(i));
+    } else {
+        int type;
+        if (!store.read(ids.at(n), obj, &type) || type != ObjectStore::COMMIT_OBJ)
+            return false;
+
+        int idx = obj.indexOf('\n') + 1; // skip "tree" line
+        while (idx > 0 && obj.mid(idx, 7) == "parent ") {
+            tmp.append(node(ObjectId(QString::fromLatin1(obj.constData() + idx + 7, 40))));
+            idx = obj.indexOf('\n', idx) + 1;
+        }
+    }
+    parentOfs[n] = parents.count();
+    parentCnt[n] = tmp.count();
+    parents += tmp;
+    return true;
+}
+
+qint64 NativeLog::commitTime(int n)
+{
+    if (graphPos.at(n) != -1)
+        return graph.commitTime(graphPos.at(n));
+
+    int type;
+    if (!store.read(ids.at(n), obj, &type))
+        return 0;
+
+    const int idx = obj.indexOf("\ncommitter ");
+    if (idx == -1)
+        return 0;
+
+    QByteArray date;
+    QByteArray dummy;
+    appendPerson(dummy, obj, idx + 11, lineEnd(obj, idx + 1, obj.size()), &date);
+    return date.toLongLong();
+}
+
+const QVector<int> NativeLog::topoOrder() const
+{
+/*
+   Same of git --topo-order: a commit is shown only after all its children
+   and, using a stack, the parents of last shown commit come first, so that
+   the commits of a merged branch are not intermixed with the main line.
+*/
+    const int cnt = ids.count();
+    QVector<int> indegree(cnt, 0);
+    for (int i = 0; i < parents.count(); i++)
+        indegree[parents.at(i)]++;
+
+    QVector<int> stack;
+    for (int i = tipNodes.count() - 1; i >= 0; i--) // most recent on top
+        if (indegree.at(tipNodes.at(i)) == 0)
+            stack.append(tipNodes.at(i));
+
+    QVector<int> order;
+    order.reserve(cnt);
+    while (!stack.isEmpty()) {
+
+        const int n = stack.last();
+        stack.pop_back();
+        order.append(n);
+
+        for (int i = parentOfs.at(n), end = i + parentCnt.at(n); i < end; i++) {
+            const int p = parents.at(i);
+            if (--indegree[p] == 0)
+                stack.append(p);
+        }
+    }
+    return order;
+}
+
+bool NativeLog::appendRecord(QByteArray& out, int n)
+{
+/*
+   Record as from 'git log --log-size -z' with main history format:
+
+       %m%HX%PX%n%cn<%ce>%n%an<%ae>%n%at%n%s%n%b
+
+   without the final %b when log messages are loaded on demand. The
+   log size counts from the boundary mark to the terminating '\0'
+*/
+    int type;
+    if (!store.read(ids.at(n), obj, &type) || type != ObjectStore::COMMIT_OBJ) {
+        dbp("WARNING: unable to read commit %1, use git log", ids.at(n).toString());
+        return false;
+    }
+    QByteArray rec;
+    rec.reserve(obj.size() + 200);
+    rec.append('>');
+    appendHex(rec, ids.at(n));
+    rec.append('X');
+    for (int i = 0; i < parentCnt.at(n); i++) {
+        if (i)
+            rec.append(' ');
+        appendHex(rec, ids.at(parents.at(parentOfs.at(n) + i)));
+    }
+    rec.append("X\n");
+
+    // headers end at first blank line
+    const char* data = obj.constData();
+    const int size = obj.size();
+    int msgStart = obj.indexOf("\n\n");
+    const int hdrEnd = (msgStart == -1 ? size : msgStart + 1);
+    msgStart = (msgStart == -1 ? size : msgStart + 2);
+
+    QByteArray author, committer, date;
+    for (int idx = 0; idx < hdrEnd; ) {
+        const int end = lineEnd(obj, idx, hdrEnd);
+        if (!strncmp(data + idx, "author ", 7))
+            appendPerson(author, obj, idx + 7, end, &date);
+        else if (!strncmp(data + idx, "committer ", 10))
+            appendPerson(committer, obj, idx + 10, end, NULL);
+        else if (!strncmp(data + idx, "encoding ", 9)) {
+            // git log re-encodes the message, we cannot
+            const QByteArray enc(obj.mid(idx + 9, end - idx - 9).trimmed().toLower());
+            if (enc != "utf-8" && enc != "utf8") {
+                dbp("WARNING: commit %1 is not UTF-8 encoded, use git log", ids.at(n).toString());
+                return false;
+            }
+        }
+
+        idx = end + 1;
+    }
+    rec.append(committer).append('\n');
+    rec.append(author).append('\n');
+    rec.append(date).append('\n');
+
+    // subject is first paragraph joined in one line, as %s does,
+    // body is what follows, after blank lines
+    int idx = msgStart;
+    bool inSubject = false;
+    while (idx < size) {
+        const int end = lineEnd(obj, idx, size);
+        const int textEnd = trimmedEnd(data, idx, end);
+        const int lineStart = idx;
+        idx = end + 1;
+
+        if (textEnd == lineStart) { // blank line
+            if (inSubject)
+                break;
+            continue;
+        }
+        if (inSubject)
+            rec.append(' ');
+
+        rec.append(data + lineStart, textEnd - lineStart);
+        inSubject = true;
+    }
+    rec.append('\n');
+
+    while (withBody && idx < size) { // skip blank lines
+        const int end = lineEnd(obj, idx, size);
+        if (trimmedEnd(data, idx, end) != idx)
+            break;
+        idx = end + 1;
+    }
+    if (withBody && idx < size)
+        rec.append(data + idx, size - idx);
+
+    out.append("log size ").append(QByteArray::number(rec.size())).append('\n');
+    out.append(rec).append('\0');
+    return true;
+}
+
+bool NativeLog::walk(const QStringList& tips, bool body)
+{
+    withBody = body;
+    FOREACH_SL (it, tips) {
+        const ObjectId id(*it);
+        if (id.isNull())
+            return false;
+
+        const int n = node(id);
+        if (!tipNodes.contains(n))
+            tipNodes.append(n);
+    }
+    if (tipNodes.isEmpty())
+        return false;
+
+    // walk the history
+    QVector<int> stack(tipNodes);
+    while (!stack.isEmpty()) {
+
+        const int n = stack.last();
+        stack.pop_back();
+        if (parentOfs.at(n) != -1)
+            continue;
+
+        if (!expand(n)) {
+            dbp("WARNING: unable to read commit %1, use git log", ids.at(n).toString());
+            return false;
+        }
+        for (int i = parentOfs.at(n), end = i + parentCnt.at(n); i < end; i++)
+            if (parentOfs.at(parents.at(i)) == -1)
+                stack.append(parents.at(i));
+    }
+    // most recent tips first, as git does
+    QVector<QPair<qint64, int> > byTime;
+    for (int i = 0; i < tipNodes.count(); i++)
+        byTime.append(qMakePair(-commitTime(tipNodes.at(i)), tipNodes.at(i)));
+
+    qStableSort(byTime);
+    for (int i = 0; i < byTime.count(); i++)
+        tipNodes[i] = byTime.at(i).second;
+
+    order = topoOrder();
+    if (order.count() != ids.count()) {
+        dbs("ASSERT in NativeLog::walk, history is not a DAG");
+        order.clear();
+        return false;
+    }
+    return true;
+}
+
+bool NativeLog::format(int from, int to, QByteArray& out)
+{
+    for (int i = from; i < to; i++)
+        if (!appendRecord(out, order.at(i)))
+            return false;
+
+    return true;
+}
+
+const QStringList NativeLog::heads() const
+{
+    QStringList h;
+    for (int i = 0; i < tipNodes.count(); i++)
+        h.append(ids.at(tipNodes.at(i)).toString());
+
+    return h;
+}
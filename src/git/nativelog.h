@@ -0,0 +1,95 @@
+#ifndef NATIVELOG_H
+#define NATIVELOG_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+#include "model/objectid.h"
+#include "commitgraph.h"
+#include "objectstore.h"
+
+// where zlib is available main history is read directly from the
+// repository, see NativeLog. Comment out following line to always
+// use 'git log' instead
+#if !defined(Q_OS_WIN32)
+#define USE_NATIVE_LOG
+#endif
+
+//! In process replacement of 'git log --topo-order' for main history
+/*!
+  Commits reachable from the given tips are walked with parents read from
+  the commit-graph file, when available, or from the commit objects, then
+  sorted in the same topological order used by git and formatted as the
+  records of 'git log --log-size', so that they are parsed as usual.
+
+  No git process is spawned and no text is parsed to know the topology,
+  commit objects are read directly from pack files. The walk is done at
+  once, records are then formatted a slice at a time, so that they can be
+  loaded while the rest is still to be read, see NativeLoader.
+
+  Replaced objects and grafts, that change the parents shown by git, are
+  not supported, caller should check with isSupported() first.
+*/
+class NativeLog
+{
+public:
+    explicit NativeLog(const QString& gitDir);
+
+    /*!
+      Walks history from \a tips, commit ids, and sorts it. Returns false
+      if some commit cannot be read. Log message body is added to records
+      only if \a withBody is set.
+    */
+    bool walk(const QStringList& tips, bool withBody = true);
+
+    /*!
+      Appends to \a out the records of walked revisions in [\a from, \a to),
+      in topological order. Returns false if some commit cannot be read or
+      would be shown differently by git.
+    */
+    bool format(int from, int to, QByteArray& out);
+
+    //! Number of revisions walked
+    int count() const { return order.count(); }
+
+    //! Loaded heads, most recent first
+    const QStringList heads() const;
+
+    //! Objects directory of repository \a gitDir, shared by linked working trees
+    static const QString objectsDir(const QString& gitDir);
+
+    //! False if history of \a gitDir has replaced objects, grafts or is shallow
+    static bool isSupported(const QString& gitDir);
+
+private:
+    // prevent implicit C++ compiler defaults
+    NativeLog(const NativeLog&);
+    NativeLog& operator=(const NativeLog&);
+
+    static const QString commonDir(const QString& gitDir);
+
+    int node(const ObjectId& id);
+    int graphNode(int pos);
+    bool expand(int n);
+    qint64 commitTime(int n);
+    const QVector<int> topoOrder() const;
+    bool appendRecord(QByteArray& out, int n);
+
+    CommitGraph graph;
+    ObjectStore store;
+    QVector<ObjectId> ids;          // by node
+    QVector<int> graphPos;          // -1 if not in commit-graph
+    QVector<int> parentOfs;         // -1 until expanded
+    QVector<int> parentCnt;
+    QVector<int> parents;           // nodes
+    QVector<int> graphNodes;        // by graph position, -1 if not a node
+    QHash<ObjectId, int> extraNodes; // not in commit-graph
+    QVector<int> tipNodes;          // most recent first
+    QVector<int> order;             // nodes, topological
+    QByteArray obj;                 // last read object
+    bool withBody;
+};
+
+#endif // NATIVELOG_H
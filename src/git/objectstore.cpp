@@ -0,0 +1,318 @@
+#include <limits.h>
+#include <zlib.h>
+#include <QDir>
+#include <QFile>
+#include <QtEndian>
+
+#include "objectstore.h"
+#include "common.h"
+
+static inline quint32 be32(const uchar* p)
+{
+    return qFromBigEndian<quint32>(p);
+}
+
+ObjectStore::ObjectStore(const QString& objectsDir) : objDir(objectsDir)
+{
+    QDir packDir(objDir + "/pack");
+    const QStringList idxList(packDir.entryList(QStringList() << "*.idx", QDir::Files));
+
+    FOREACH_SL (it, idxList)
+        if (!openPack(packDir.absoluteFilePath(*it)))
+            dbp("WARNING: unable to open pack index %1", *it);
+}
+
+ObjectStore::~ObjectStore()
+{
+    // deleting the files releases the mappings
+    for (int i = 0; i < packs.count(); i++) {
+        delete packs.at(i).idxFile;
+        delete packs.at(i).packFile;
+    }
+}
+
+bool ObjectStore::openPack(const QString& idxPath)
+{
+    QString packPath(idxPath);
+    packPath.replace(packPath.length() - 4, 4, ".pack");
+
+    Pack p;
+    p.idxFile = new QFile(idxPath);
+    p.packFile = new QFile(packPath);
+
+    bool ok = (   p.idxFile->open(QIODevice::ReadOnly)
+               && p.packFile->open(QIODevice::ReadOnly));
+    if (ok) {
+        const qint64 idxSize = p.idxFile->size();
+        p.packSize = p.packFile->size();
+        p.idx = p.idxFile->map(0, idxSize);
+        p.pack = p.packFile->map(0, p.packSize);
+
+        // version 2 index: magic, version, fan-out table, ids, crc, offsets
+        ok = (   p.idx && p.pack && idxSize >= 8 + 256 * 4 && p.packSize >= 12
+              && be32(p.idx) == 0xFF744F63 && be32(p.idx + 4) == 2
+              && !memcmp(p.pack, "PACK", 4));
+        if (ok) {
+            p.count = be32(p.idx + 8 + 255 * 4);
+            ok = (idxSize >= 8 + 256 * 4 + (qint64)p.count * 28);
+        }
+    }
+    if (!ok) {
+        delete p.idxFile;
+        delete p.packFile;
+        return false;
+    }
+    packs.append(p);
+    return true;
+}
+
+qint64 ObjectStore::findOffset(const Pack& p, const ObjectId& id) const
+{
+    // binary search among ids with the same first byte
+    const uchar* key = id.raw();
+    const uchar* fanout = p.idx + 8;
+    const uchar* ids = fanout + 256 * 4;
+
+    quint32 lo = (key[0] ? be32(fanout + (key[0] - 1) * 4) : 0);
+    quint32 hi = be32(fanout + key[0] * 4);
+
+    while (lo < hi) {
+        const quint32 mid = lo + (hi - lo) / 2;
+        const int cmp = memcmp(ids + mid * 20, key, 20);
+        if (cmp == 0) {
+            const uchar* ofsTable = ids + p.count * 24; // after ids and crc
+            quint32 ofs = be32(ofsTable + mid * 4);
+            if (!(ofs & 0x80000000))
+                return ofs;
+
+            // offset is in 64 bit table, for packs bigger then 2GB
+            const uchar* large = ofsTable + p.count * 4 + (ofs & 0x7FFFFFFF) * 8;
+            return ((qint64)be32(large) << 32) | be32(large + 4);
+        }
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+bool ObjectStore::read(const ObjectId& id, QByteArray& data, int* type)
+{
+    return read(id, data, type, 0);
+}
+
+bool ObjectStore::read(const ObjectId& id, QByteArray& data, int* type, int depth)
+{
+    // 'depth' is of the delta chain, also across packs, see readPacked()
+    for (int i = 0; i < packs.count(); i++) {
+        const qint64 ofs = findOffset(packs.at(i), id);
+        if (ofs != -1)
+            return readPacked(packs.at(i), ofs, data, type, depth);
+    }
+    return readLoose(id, data, type);
+}
+
+bool ObjectStore::readPacked(const Pack& p, qint64 ofs, QByteArray& data, int* type, int depth)
+{
+    if (ofs < 12 || ofs >= p.packSize || depth > MAX_DELTA_DEPTH)
+        return false;
+
+    const uchar* ptr = p.pack + ofs;
+    const uchar* end = p.pack + p.packSize;
+
+    // entry header, type and inflated size as a variable length integer
+    uint c = *ptr++;
+    int objType = (int)((c >> 4) & 7);
+    qint64 size = c & 15;
+    int shift = 4;
+    while ((c & 0x80) && ptr < end && shift < 57) {
+        c = *ptr++;
+        size |= (qint64)(c & 0x7F) << shift;
+        shift += 7;
+    }
+    if (objType == OFS_DELTA || objType == REF_DELTA) {
+
+        QByteArray base;
+        if (objType == OFS_DELTA) {
+            // base is before us, at a negative offset with its own encoding
+            if (ptr >= end)
+                return false;
+
+            c = *ptr++;
+            qint64 baseOfs = c & 0x7F;
+            while ((c & 0x80) && ptr < end) {
+                c = *ptr++;
+                baseOfs = ((baseOfs + 1) << 7) | (c & 0x7F);
+            }
+            if (!readPacked(p, ofs - baseOfs, base, &objType, depth + 1))
+                return false;
+        } else {
+            if (ptr + 20 > end)
+                return false;
+
+            const ObjectId baseId(ObjectId::fromRaw(ptr));
+            ptr += 20;
+            if (!read(baseId, base, &objType, depth + 1))
+                return false;
+        }
+        QByteArray delta;
+        if (!inflateData(ptr, end - ptr, delta, size) || !applyDelta(base, delta, data))
+            return false;
+
+    } else if (objType >= COMMIT_OBJ && objType <= TAG_OBJ) {
+        if (!inflateData(ptr, end - ptr, data, size))
+            return false;
+    } else
+        return false;
+
+    if (type)
+        *type = objType;
+
+    return true;
+}
+
+bool ObjectStore::readLoose(const ObjectId& id, QByteArray& data, int* type)
+{
+    const QString hex(id.toString());
+    QFile f(objDir + '/' + hex.left(2) + '/' + hex.mid(2));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray z(f.readAll());
+    QByteArray buf;
+    if (!inflateData((const uchar*)z.constData(), z.size(), buf, -1))
+        return false;
+
+    // loose object is "<type> <size>\0<content>"
+    const int sp = buf.indexOf(' ');
+    const int nul = buf.indexOf('\0');
+    if (sp == -1 || nul < sp)
+        return false;
+
+    const QByteArray typeName(buf.left(sp));
+    int objType = BAD_OBJ;
+    if (typeName == "commit")
+        objType = COMMIT_OBJ;
+    else if (typeName == "tree")
+        objType = TREE_OBJ;
+    else if (typeName == "blob")
+        objType = BLOB_OBJ;
+    else if (typeName == "tag")
+        objType = TAG_OBJ;
+
+    bool ok;
+    const int size = buf.mid(sp + 1, nul - sp - 1).toInt(&ok);
+    if (objType == BAD_OBJ || !ok || size != buf.size() - nul - 1)
+        return false;
+
+    data = buf.mid(nul + 1);
+    if (type)
+        *type = objType;
+
+    return true;
+}
+
+bool ObjectStore::inflateData(const uchar* src, qint64 srcLen, QByteArray& dst, qint64 size)
+{
+    // when 'size' is not known, as with loose objects, it is
+    // -1 and output buffer is enlarged as needed
+    if (size > INT_MAX - 1)
+        return false;
+
+    int cap = (size >= 0 ? (int)size + 1 : 4096); // one more to detect overflows
+    dst.resize(cap);
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    zs.next_in = const_cast<Bytef*>(src);
+    zs.avail_in = (uInt)qMin(srcLen, (qint64)INT_MAX);
+    if (inflateInit(&zs) != Z_OK)
+        return false;
+
+    int ret = Z_OK;
+    do {
+        if ((int)zs.total_out == dst.size()) {
+            if (size >= 0 || dst.size() > INT_MAX / 2)
+                break; // more data than expected
+
+            dst.resize(dst.size() * 2);
+        }
+        zs.next_out = (Bytef*)dst.data() + zs.total_out;
+        zs.avail_out = (uInt)(dst.size() - (int)zs.total_out);
+        ret = inflate(&zs, Z_NO_FLUSH);
+
+    } while (ret == Z_OK);
+
+    const int len = (int)zs.total_out;
+    inflateEnd(&zs);
+
+    bool ok = (ret == Z_STREAM_END && (size < 0 || len == size));
+    dst.resize(ok ? len : 0);
+    return ok;
+}
+
+bool ObjectStore::applyDelta(const QByteArray& base, const QByteArray& delta, QByteArray& out)
+{
+/*
+   A delta is the size of the base and of the result, as variable length
+   integers, followed by instructions to copy a range of the base or to
+   insert new data from the delta itself.
+*/
+    const uchar* ptr = (const uchar*)delta.constData();
+    const uchar* end = ptr + delta.size();
+    qint64 sizes[2] = { 0, 0 };
+
+    for (int i = 0; i < 2; i++) {
+        int shift = 0;
+        uint c;
+        do {
+            if (ptr >= end || shift > 56)
+                return false;
+
+            c = *ptr++;
+            sizes[i] |= (qint64)(c & 0x7F) << shift;
+            shift += 7;
+        } while (c & 0x80);
+    }
+    if (sizes[0] != base.size() || sizes[1] > INT_MAX)
+        return false;
+
+    out.resize((int)sizes[1]);
+    char* dst = out.data();
+    int outLen = 0;
+
+    while (ptr < end) {
+        const uint op = *ptr++;
+        if (op & 0x80) { // copy from base, offset and size bytes are optional
+            quint32 cpOfs = 0, cpSize = 0;
+            for (int i = 0; i < 4; i++)
+                if ((op & (1u << i)) && ptr < end)
+                    cpOfs |= (quint32)*ptr++ << (i * 8);
+
+            for (int i = 0; i < 3; i++)
+                if ((op & (0x10u << i)) && ptr < end)
+                    cpSize |= (quint32)*ptr++ << (i * 8);
+
+            if (cpSize == 0)
+                cpSize = 0x10000;
+
+            if (   (qint64)cpOfs + cpSize > base.size()
+                || (qint64)outLen + cpSize > out.size())
+                return false;
+
+            memcpy(dst + outLen, base.constData() + cpOfs, cpSize);
+            outLen += (int)cpSize;
+
+        } else if (op) { // insert 'op' bytes of literal data
+            if (ptr + op > end || outLen + (int)op > out.size())
+                return false;
+
+            memcpy(dst + outLen, ptr, op);
+            ptr += op;
+            outLen += (int)op;
+        } else
+            return false; // reserved
+    }
+    return outLen == out.size();
+}
@@ -0,0 +1,76 @@
+#ifndef OBJECTSTORE_H
+#define OBJECTSTORE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "model/objectid.h"
+
+class QFile;
+
+//! Read only access to the objects of a repository
+/*!
+  Objects are looked up first in the pack files, through their version 2
+  index, and then among the loose objects. Pack and index files are memory
+  mapped, entries are inflated with zlib and deltas, both by offset and by
+  reference, are resolved recursively.
+
+  Objects in alternates or in packs with an old version 1 index are not
+  found, caller is expected to fall back on git in that case.
+*/
+class ObjectStore
+{
+public:
+    enum ObjectType {
+        BAD_OBJ    = 0,
+        COMMIT_OBJ = 1,
+        TREE_OBJ   = 2,
+        BLOB_OBJ   = 3,
+        TAG_OBJ    = 4
+    };
+
+    //! Opens the packs of \a objectsDir, as example ".git/objects"
+    explicit ObjectStore(const QString& objectsDir);
+    ~ObjectStore();
+
+    /*!
+      Reads object \a id content in \a data.
+      \return false if object is not found or is corrupted.
+    */
+    bool read(const ObjectId& id, QByteArray& data, int* type = NULL);
+
+private:
+    // prevent implicit C++ compiler defaults
+    ObjectStore(const ObjectStore&);
+    ObjectStore& operator=(const ObjectStore&);
+
+    enum {
+        OFS_DELTA = 6,
+        REF_DELTA = 7,
+        MAX_DELTA_DEPTH = 4096
+    };
+
+    struct Pack
+    {
+        QFile* idxFile;
+        QFile* packFile;
+        const uchar* idx;
+        const uchar* pack;
+        qint64 packSize;
+        quint32 count;
+    };
+
+    bool read(const ObjectId& id, QByteArray& data, int* type, int depth);
+    bool openPack(const QString& idxPath);
+    qint64 findOffset(const Pack& p, const ObjectId& id) const;
+    bool readPacked(const Pack& p, qint64 ofs, QByteArray& data, int* type, int depth);
+    bool readLoose(const ObjectId& id, QByteArray& data, int* type);
+    static bool inflateData(const uchar* src, qint64 srcLen, QByteArray& dst, qint64 size);
+    static bool applyDelta(const QByteArray& base, const QByteArray& delta, QByteArray& out);
+
+    QString objDir;
+    QList<Pack> packs;
+};
+
+#endif // OBJECTSTORE_H
@@ -6,12 +6,12 @@ References::References(RunGitInterface* git) : m_git(git), patchesStillToFind(0)
 
 }
 
-bool References::containsSha(const ShaString& sha) const
+bool References::containsSha(const ObjectId& sha) const
 {
     return m_shaToRef.contains(sha);
 }
 
-ReferenceList References::filter(const ShaString& sha, uint typeMask) const
+ReferenceList References::filter(const ObjectId& sha, uint typeMask) const
 {
     ShaToReferenceInfoList::const_iterator it(m_shaToRef.constFind(sha));
     if (it == m_shaToRef.constEnd()) {
@@ -26,7 +26,7 @@ ReferenceList References::filter(const ShaString& sha, uint typeMask) const
     return list;
 }
 
-uint References::containsType(const ShaString& sha, uint typeMask) const
+uint References::containsType(const ObjectId& sha, uint typeMask) const
 {
     ShaToReferenceInfoList::const_iterator it(m_shaToRef.constFind(sha));
     if (it == m_shaToRef.constEnd()) return 0;
@@ -91,7 +91,7 @@ void References::clear()
 
 void References::add(Reference* ref)
 {
-    const ShaString& sha = ref->sha();
+    const ObjectId sha(ref->sha());
     m_refs.append(ref);
     ShaToReferenceInfoList::iterator it = m_shaToRef.find(sha);
     if (it != m_shaToRef.end()) {
@@ -107,7 +107,7 @@ void References::add(Reference* ref)
 void References::remove(Reference* ref)
 {
     m_refs.removeOne(ref);
-    const ShaString& sha = ref->sha();
+    const ObjectId sha(ref->sha());
 
     ShaToReferenceInfoList::iterator it = m_shaToRef.find(sha);
     if (it != m_shaToRef.end()) {
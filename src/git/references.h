@@ -8,6 +8,7 @@
 #include <QVector>
 
 #include "model/shastring.h"
+#include "model/objectid.h"
 #include "model/reference.h"
 #include "model/tagreference.h"
 #include "model/stgitpatchreference.h"
@@ -23,7 +24,7 @@ class References
 private:
     RunGitInterface* m_git;
 
-    typedef QHash<ShaString, ReferenceList> ShaToReferenceInfoList;
+    typedef QHash<ObjectId, ReferenceList> ShaToReferenceInfoList;
     ReferenceList m_refs;
     ShaToReferenceInfoList m_shaToRef;
     QVector<QByteArray> m_shaBackupBuf;
@@ -42,17 +43,17 @@ public:
     /*!
       \return true if any reference with given sha exists.
     */
-    bool containsSha(const ShaString& sha) const;
+    bool containsSha(const ObjectId& sha) const;
 
     /*!
       \return combination of type of all references that has given SHA.
     */
-    uint containsType(const ShaString& sha, uint typeMask = Reference::ANY_TYPE) const;
+    uint containsType(const ObjectId& sha, uint typeMask = Reference::ANY_TYPE) const;
 
     /*!
       Filter list of references that has given sha and type.
     */
-    ReferenceList filter(const ShaString& sha, uint typeMask = Reference::ANY_TYPE) const;
+    ReferenceList filter(const ObjectId& sha, uint typeMask = Reference::ANY_TYPE) const;
 
     /*!
       \return List of sha of all references with given type.
@@ -0,0 +1,251 @@
+#include <limits.h>
+#include <QTemporaryFile>
+
+#include "shardedlog.h"
+#include "common.h"
+#include "dataloader.h"
+#include "git.h"
+
+ShardedLog::ShardedLog(Git* g, FileHistory* f, DataLoader* dl) : QObject(g), fh(f), loader(dl)
+{
+    maxShards = 1;
+    revList = NULL;
+    revsFile = NULL;
+    nextShard = 0;
+    lastFedIsEnd = true;
+    canceling = false;
+
+    connect(g, SIGNAL(cancelAllProcesses()), this, SLOT(on_cancel()));
+    connect(g, SIGNAL(cancelLoading(const FileHistory*)),
+            this, SLOT(on_cancel(const FileHistory*)));
+}
+
+ShardedLog::~ShardedLog()
+{
+    // processes must be gone before their files
+    delete revList;
+    qDeleteAll(procs);
+    delete revsFile;
+    qDeleteAll(inFiles);
+    qDeleteAll(outFiles);
+}
+
+QProcess* ShardedLog::newProcess(const QString& stdinFile, const QString& stdoutFile)
+{
+    QProcess* p = new QProcess();
+    p->setWorkingDirectory(workDir);
+
+    // git reads and writes straight from and to files, without going through us
+    if (!stdinFile.isEmpty())
+        p->setStandardInputFile(stdinFile);
+
+    if (!stdoutFile.isEmpty())
+        p->setStandardOutputFile(stdoutFile);
+
+    return p;
+}
+
+bool ShardedLog::start(const QStringList& cmd, const QStringList& heads,
+                       const QString& wd, int shards)
+{
+    logCmd = cmd;
+    workDir = wd;
+    maxShards = shards;
+
+    // revisions are listed asynchronously, in a file, one byte per char
+    revsFile = new QTemporaryFile();
+    if (!revsFile->open()) {
+        on_cancel();
+        return false;
+    }
+    revList = newProcess("", revsFile->fileName());
+    connect(revList, SIGNAL(finished(int, QProcess::ExitStatus)),
+            this, SLOT(on_listed(int, QProcess::ExitStatus)));
+
+    QStringList args;
+    args << "git" << "rev-list" << "--topo-order" << heads;
+    if (!QGit::startProcess(revList, args)) {
+        on_cancel();
+        return false;
+    }
+    return true;
+}
+
+void ShardedLog::on_cancel(const FileHistory* f)
+{
+    if (f == fh)
+        on_cancel();
+}
+
+void ShardedLog::on_cancel()
+{
+    if (!canceling) { // just once
+        canceling = true;
+        if (revList) {
+            revList->disconnect(this);
+            revList->kill();
+        }
+        FOREACH (QList<QProcess*>, it, procs) {
+            (*it)->disconnect(this);
+            (*it)->kill();
+        }
+        deleteLater();
+    }
+}
+
+void ShardedLog::fail()
+{
+    dbs("ASSERT in ShardedLog, unable to run 'git log' in parallel");
+    on_cancel();
+    emit failed();
+}
+
+void ShardedLog::on_listed(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    if (canceling)
+        return;
+
+    // each line is a sha plus '\n'
+    const int lineLen = 41;
+    const qint64 size = revsFile->size();
+    if (   exitStatus != QProcess::NormalExit || exitCode != 0
+        || size == 0 || size % lineLen != 0) {
+        fail();
+        return;
+    }
+    const qint64 revsCnt = size / lineLen;
+    emit listed((int)qMin(revsCnt, (qint64)INT_MAX));
+
+    if (!startShards(revsCnt))
+        fail();
+}
+
+bool ShardedLog::startShards(qint64 revsCnt)
+{
+    const int lineLen = 41;
+    const int cnt = (int)qBound((qint64)1, revsCnt / MIN_LOG_SHARD_SIZE, (qint64)maxShards);
+    if (!revsFile->seek(0))
+        return false;
+
+    for (int i = 0; i < cnt; i++) {
+
+        // slices are contiguous, copied from the list a block at a time
+        QTemporaryFile* in = new QTemporaryFile();
+        inFiles.append(in);
+        if (!in->open())
+            return false;
+
+        qint64 left = (revsCnt * (i + 1) / cnt - revsCnt * i / cnt) * lineLen;
+        while (left > 0) {
+            const QByteArray block(revsFile->read(qMin(left, (qint64)FEED_BLOCK_SIZE)));
+            if (block.isEmpty() || in->write(block) != block.size())
+                return false;
+
+            left -= block.size();
+        }
+        in->close(); // file is kept until deleted
+
+        // first slice output is streamed, the others wait their turn in a file
+        QTemporaryFile* out = NULL;
+        if (i > 0) {
+            out = new QTemporaryFile();
+            if (!out->open()) {
+                delete out;
+                return false;
+            }
+        }
+        outFiles.append(out);
+
+        QProcess* p = newProcess(in->fileName(), out ? out->fileName() : "");
+        procs.append(p);
+        exited.append(false);
+
+        connect(p, SIGNAL(finished(int, QProcess::ExitStatus)),
+                this, SLOT(on_finished(int, QProcess::ExitStatus)));
+        if (!out)
+            connect(p, SIGNAL(readyReadStandardOutput()), this, SLOT(on_readyRead()));
+
+        if (!QGit::startProcess(p, logCmd))
+            return false;
+    }
+    delete revsFile; // not needed anymore
+    revsFile = NULL;
+    return true;
+}
+
+void ShardedLog::on_readyRead()
+{
+    if (!canceling)
+        feed(new QByteArray(procs.first()->readAllStandardOutput()));
+}
+
+void ShardedLog::on_finished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    if (canceling)
+        return;
+
+    const int i = procs.indexOf(static_cast<QProcess*>(sender()));
+    if (i == -1)
+        return;
+
+    if (exitStatus != QProcess::NormalExit || exitCode != 0) {
+        fail();
+        return;
+    }
+    exited[i] = true;
+    if (!feedShards())
+        fail();
+}
+
+bool ShardedLog::feedShards()
+{
+    // outputs are fed in slice order, each one as soon as the previous are
+    while (nextShard < procs.count() && exited.at(nextShard)) {
+
+        if (nextShard == 0) // what is still to be read
+            feed(new QByteArray(procs.first()->readAllStandardOutput()));
+        else {
+            QTemporaryFile* f = outFiles.at(nextShard);
+            qint64 left = f->size();
+            if (!f->seek(0))
+                return false;
+
+            // records are '\0' terminated but the last one of each output
+            if (!lastFedIsEnd)
+                feed(new QByteArray(1, '\0'));
+
+            while (left > 0) {
+                QByteArray* ba = new QByteArray(f->read(qMin(left, (qint64)FEED_BLOCK_SIZE)));
+                if (ba->isEmpty()) {
+                    delete ba;
+                    return false;
+                }
+                left -= ba->size();
+                feed(ba);
+            }
+            delete f; // free disk space as soon as possible
+            outFiles[nextShard] = NULL;
+        }
+        nextShard++;
+    }
+    if (nextShard == procs.count()) {
+        if (loader)
+            loader->feed(NULL, true);
+
+        canceling = true; // done, ignore any further request
+        deleteLater();
+    }
+    return true;
+}
+
+void ShardedLog::feed(QByteArray* data)
+{
+    // loader takes ownership of data
+    if (!data->isEmpty())
+        lastFedIsEnd = (data->at(data->size() - 1) == '\0');
+
+    if (loader)
+        loader->feed(data, false);
+    else
+        delete data;
+}
@@ -0,0 +1,76 @@
+#ifndef SHARDEDLOG_H
+#define SHARDEDLOG_H
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QProcess>
+#include <QStringList>
+
+class DataLoader;
+class Git;
+class FileHistory;
+class QTemporaryFile;
+
+//! Formats a history with many 'git log' processes in parallel
+/*!
+  Revisions are first listed in topological order by 'git rev-list', that
+  is much faster than formatting them, then the list is split in contiguous
+  slices and each slice is given to its own 'git log --no-walk=unsorted
+  --stdin' process.
+
+  Output of the first slice, the top of the history, is fed to a DataLoader
+  as it comes, so that first rows are shown soon, outputs of the others are
+  written to temporary files and fed in slice order when their turn comes,
+  so that the result is the same of a single 'git log' over the whole list.
+
+  Auto-deleted when done or canceled, in the latter case nothing more is
+  fed. In case of errors failed() is sent and caller should load the
+  history in another way, also when some data has been already fed.
+*/
+class ShardedLog : public QObject
+{
+    Q_OBJECT
+public:
+    ShardedLog(Git* g, FileHistory* f, DataLoader* dl);
+    ~ShardedLog();
+    bool start(const QStringList& logCmd, const QStringList& heads,
+               const QString& wd, int maxShards);
+
+signals:
+    void listed(int revsCnt);
+    void failed();
+
+private slots:
+    void on_listed(int, QProcess::ExitStatus);
+    void on_readyRead();
+    void on_finished(int, QProcess::ExitStatus);
+    void on_cancel();
+    void on_cancel(const FileHistory*);
+
+private:
+    enum { FEED_BLOCK_SIZE = 16 * 1024 * 1024 };
+
+    QProcess* newProcess(const QString& stdinFile, const QString& stdoutFile);
+    bool startShards(qint64 revsCnt);
+    bool feedShards();
+    void feed(QByteArray* data);
+    void fail();
+
+    FileHistory* fh;
+    QPointer<DataLoader> loader;
+    QStringList logCmd;
+    QString workDir;
+    int maxShards;
+    QProcess* revList;
+    QTemporaryFile* revsFile;
+    QList<QProcess*> procs;
+    QList<QTemporaryFile*> inFiles;
+    QList<QTemporaryFile*> outFiles; // NULL for the first slice, streamed
+    QList<bool> exited;
+    int nextShard; // first slice not yet fed
+    bool lastFedIsEnd; // last fed byte is a record terminator
+    bool canceling;
+};
+
+#endif // SHARDEDLOG_H
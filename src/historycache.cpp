@@ -0,0 +1,124 @@
+/*
+    Description: main history persistent cache
+
+    Author: Marco Costalba (C) 2005-2007
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include <limits.h>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include "filehistory.h"
+#include "historycache.h"
+
+using namespace QGit;
+
+bool HistoryCache::save(SCRef gitDir, SCList args, SCList heads, bool withBody, const FileHistory* fh)
+{
+    if (gitDir.isEmpty() || fh->graph.count() == 0)
+        return false;
+
+    QString path(gitDir + H_DAT_FILE);
+    QString tmpPath(path + BAK_EXT);
+
+    QDir dir;
+    if (!dir.exists(gitDir)) {
+        dbs("Git directory not found, unable to save history cache");
+        return false;
+    }
+    QFile f(tmpPath);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Unbuffered))
+        return false;
+
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+
+    // Write a header with a "magic number" and a version
+    stream << (quint32)H_MAGIC;
+    stream << (qint32)H_VERSION;
+    stream << args;
+    stream << heads;
+    stream << withBody;
+
+    // data is not compressed, it must be mapped as is when loading
+    QByteArray data;
+    const RevGraph& g = fh->graph;
+    for (int row = 0; row < g.count(); row++) {
+
+        const Revision* r = g.revision(row);
+        if (!r->isDiffCache) // skip working dir, it is not a git object
+            r->appendRecord(data);
+    }
+    bool ok = (f.write(header) == header.size() && f.write(data) == data.size());
+    f.close();
+
+    if (!ok) {
+        dbs("ASSERT in HistoryCache::save, unable to write " + tmpPath);
+        dir.remove(tmpPath);
+        return false;
+    }
+    // rename H_DAT_FILE + BAK_EXT -> H_DAT_FILE
+    if (dir.exists(path)) {
+        if (!dir.remove(path)) {
+            dbs("access denied to " + path);
+            dir.remove(tmpPath);
+            return false;
+        }
+    }
+    dir.rename(tmpPath, path);
+    return true;
+}
+
+QByteArray* HistoryCache::load(SCRef gitDir, SCList args, bool withBody, QStringList& heads, QFile** file)
+{
+/*
+   Returns the cached records, to be parsed as 'git log' output, or NULL
+   if there is no valid cache for 'args' and 'withBody'. When the file is memory mapped
+   it is returned in 'file' and must outlive the returned buffer.
+*/
+    *file = NULL;
+    QFile* f = new QFile(gitDir + H_DAT_FILE);
+
+    // revisions parsing writes '\0' terminators in the data, so we need
+    // the mapped pages to be writable, but saved records have them already
+    // and pages are left clean, see Revision::indexData()
+    if (!f->exists() || !f->open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+        delete f;
+        return NULL;
+    }
+    QDataStream stream(f);
+    quint32 magic = 0;
+    qint32 version = 0;
+    QStringList cachedArgs;
+    bool cachedWithBody = !withBody;
+    stream >> magic;
+    stream >> version;
+    if (magic == H_MAGIC && version == H_VERSION) {
+        stream >> cachedArgs;
+        stream >> heads;
+        stream >> cachedWithBody;
+    }
+    qint64 ofs = f->pos();
+    qint64 len = f->size() - ofs;
+
+    bool ok = (   stream.status() == QDataStream::Ok
+               && magic == H_MAGIC && version == H_VERSION
+               && cachedArgs == args && cachedWithBody == withBody
+               && !heads.isEmpty()
+               && len > 0 && len < INT_MAX);
+    if (!ok) {
+        heads.clear();
+        delete f;
+        return NULL;
+    }
+    uchar* data = f->map(ofs, len);
+    if (data) {
+        *file = f;
+        return new QByteArray(QByteArray::fromRawData((const char*)data, (int)len));
+    }
+    QByteArray* ba = new QByteArray(f->readAll()); // mapping not available
+    delete f;
+    return ba;
+}
@@ -0,0 +1,32 @@
+/*
+    Author: Marco Costalba (C) 2005-2007
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#ifndef HISTORYCACHE_H
+#define HISTORYCACHE_H
+
+#include "common.h"
+
+class QFile;
+class FileHistory;
+
+/*
+   Main history persistent cache
+
+   Revisions are saved as the same 'git log' records we parse at startup,
+   in history order, after a small header with the loading arguments and
+   the history heads, so that at next startup the file is simply mapped
+   and parsed in place, and only revisions not reachable from the cached
+   heads are asked to git. Records could be without log message body, see
+   LOG_ON_DEMAND_F, so this is saved too.
+*/
+class HistoryCache
+{
+public:
+    static bool save(SCRef gitDir, SCList args, SCList heads, bool withBody, const FileHistory* fh);
+    static QByteArray* load(SCRef gitDir, SCList args, bool withBody, QStringList& heads, QFile** file);
+};
+
+#endif
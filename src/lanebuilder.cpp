@@ -0,0 +1,68 @@
+/*
+    Description: worker thread that computes graph lanes
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include "common.h"
+#include "git.h"
+#include "lanebuilder.h"
+#include "loadstats.h"
+
+LaneBuilder::LaneBuilder(QObject* p, const FileHistory* f, const QVector<const Revision*>& r,
+                         const Lanes& state, int first, LaneStore* s)
+                        : QThread(p), fh(f), rows(r), lns(state), firstRow(first), store(s)
+{
+    canceling = false;
+}
+
+LaneBuilder::~LaneBuilder()
+{
+    cancel();
+    wait();
+}
+
+void LaneBuilder::cancel()
+{
+    // chunks not yet taken are thrown away
+    canceling = true;
+}
+
+void LaneBuilder::takeChunks(QList<Chunk>& c)
+{
+    QMutexLocker locker(&mutex);
+    c = chunks;
+    chunks.clear();
+}
+
+void LaneBuilder::run()
+{
+    for (int row = firstRow, cnt = rows.count(); row < cnt && !canceling; ) {
+
+        const qint64 startTime = LoadStats::now();
+        const int last = qMin(row + (int)CHUNK_ROWS, cnt);
+
+        Chunk c;
+        c.first = row;
+        c.lanes.resize(last - row);
+
+        QVector<LaneType> lanes;
+        for ( ; row < last && !canceling; row++) {
+            const Revision* r = rows.at(row);
+            if (r->lanes.isEmpty()) { // unapplied patches have them already
+                Git::updateLanes(*r, lns, ObjectId(r->sha()), lanes);
+                c.lanes[row - c.first] = store->intern(lanes);
+            }
+        }
+        if (canceling)
+            return;
+
+        c.state = lns;
+        c.buildTime = LoadStats::now() - startTime;
+
+        mutex.lock();
+        chunks.append(c);
+        mutex.unlock();
+        emit lanesReady();
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef LANEBUILDER_H
+#define LANEBUILDER_H
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+
+#include "lanes.h"
+#include "model/lanestore.h"
+
+class FileHistory;
+class Revision;
+
+/*
+   Computes graph lanes of a whole history in a worker thread, so that
+   jumping to the bottom of a big history does not compute all the
+   missing lanes in a paint event.
+
+   Rows are processed in chunks, each one is sent with lanesReady() and
+   collected by the caller with takeChunks(), together with the state of
+   the lanes after its last row, so that lanes are published in order and
+   rows not yet ready are shown as placeholders meanwhile.
+
+   Revisions are only read, caller must cancel the builder before any of
+   them is changed or destroyed.
+*/
+class LaneBuilder : public QThread
+{
+    Q_OBJECT
+public:
+    struct Chunk
+    {
+        Chunk() : first(0), buildTime(0) {}
+
+        int first;                         // row of lanes.first()
+        QVector<PackedLanes> lanes;        // by row
+        Lanes state;                       // after last row of the chunk
+        qint64 buildTime;                  // usecs, see LoadStats
+    };
+
+    LaneBuilder(QObject* parent, const FileHistory* fh, const QVector<const Revision*>& rows,
+                const Lanes& state, int first, LaneStore* store);
+    ~LaneBuilder();
+    const FileHistory* history() const { return fh; }
+    void takeChunks(QList<Chunk>& c);
+    void cancel();
+
+signals:
+    void lanesReady();
+
+protected:
+    virtual void run();
+
+private:
+    enum { CHUNK_ROWS = 4096 };
+
+    const FileHistory* fh;
+    const QVector<const Revision*> rows;
+    Lanes lns;
+    const int firstRow;
+    LaneStore* store;
+
+    QMutex mutex;
+    QList<Chunk> chunks; // built and not yet taken
+    volatile bool canceling; // polled without lock while building
+};
+
+#endif
@@ -6,26 +6,33 @@
     Copyright: See COPYING file that comes with this distribution
 
 */
-#include <QStringList>
 #include "common.h"
 #include "lanes.h"
 
 #define IS_NODE(x) (x == NODE || x == NODE_R || x == NODE_L)
+#define IS_GAP(x) (x == LANE_EMPTY || x == LANE_CROSS_EMPTY)
 
 using namespace QGit;
 
-void Lanes::init(const QString& expectedSha)
+void Lanes::init(const ObjectId& expected)
 {
     clear();
     activeLane = 0;
     setBoundary(false);
-    add(LANE_BRANCH, expectedSha, activeLane);
+    add(LANE_BRANCH, expected, activeLane);
 }
 
 void Lanes::clear()
 {
     typeVec.clear();
     nextShaVec.clear();
+    nextShaLanes.clear();
+    rowNum = foldedCnt = 0;
+    events.clear();
+    prevEvents.clear();
+    lastEventRow.clear();
+    colOfLane.clear();
+    laneOfCol.clear();
 }
 
 void Lanes::setBoundary(bool b)
@@ -41,36 +48,27 @@ void Lanes::setBoundary(bool b)
         typeVec[activeLane] = LANE_BOUNDARY;
 }
 
-bool Lanes::isFork(const QString& sha, bool& isDiscontinuity)
+bool Lanes::isFork(const ObjectId& id, bool& isDiscontinuity)
 {
-    int pos = findNextSha(sha, 0);
+    int cnt;
+    int pos = findNextSha(id, &cnt);
     isDiscontinuity = (activeLane != pos);
-    if (pos == -1) // new branch case
-        return false;
-
-    return (findNextSha(sha, pos + 1) != -1);
-/*
-    int cnt = 0;
-    while (pos != -1) {
-        cnt++;
-        pos = findNextSha(sha, pos + 1);
-//        if (isDiscontinuity)
-//            isDiscontinuity = (activeLane != pos);
-    }
-    return (cnt > 1);
-*/
+    return (cnt > 1); // false also in new branch case
 }
 
-void Lanes::setFork(const QString& sha)
+void Lanes::setFork(const ObjectId& id)
 {
-    int rangeStart, rangeEnd, idx;
-    rangeStart = rangeEnd = idx = findNextSha(sha, 0);
+    int rangeStart = activeLane, rangeEnd = activeLane;
 
-    while (idx != -1) {
-        rangeEnd = idx;
-        typeVec[idx] = LANE_TAIL;
-        idx = findNextSha(sha, idx + 1);
+    QMultiHash<ObjectId, int>::const_iterator it(nextShaLanes.constFind(id));
+    for ( ; it != nextShaLanes.constEnd() && it.key() == id; ++it) {
+        rangeStart = qMin(rangeStart, it.value());
+        rangeEnd = qMax(rangeEnd, it.value());
+        typeVec[it.value()] = LANE_TAIL;
+        touch(it.value());
     }
+    forkStart = rangeStart;
+    forkEnd = rangeEnd;
     typeVec[activeLane] = NODE;
 
     LaneType& startT = typeVec[rangeStart];
@@ -100,7 +98,7 @@ void Lanes::setFork(const QString& sha)
     }
 }
 
-void Lanes::setMerge(const QStringList& parents)
+void Lanes::setMerge(const QVector<ObjectId>& parents)
 {
 // setFork() must be called before setMerge()
 
@@ -116,10 +114,9 @@ void Lanes::setMerge(const QStringList& parents)
     t = NODE;
 
     int rangeStart = activeLane, rangeEnd = activeLane;
-    QStringList::const_iterator it(parents.constBegin());
-    for (++it; it != parents.constEnd(); ++it) { // skip first parent
+    for (int i = 1; i < parents.count(); i++) { // skip first parent
 
-        int idx = findNextSha(*it, 0);
+        int idx = findNextSha(parents.at(i));
         if (idx != -1) {
 
             if (idx > rangeEnd) {
@@ -136,8 +133,12 @@ void Lanes::setMerge(const QStringList& parents)
 
             typeVec[idx] = LANE_JOIN;
         } else
-            rangeEnd = add(LANE_HEAD, *it, rangeEnd + 1);
+            idx = rangeEnd = add(LANE_HEAD, parents.at(i), rangeEnd + 1);
+
+        touch(idx);
     }
+    mergeStart = rangeStart;
+    mergeEnd = rangeEnd;
     LaneType& startT = typeVec[rangeStart];
     LaneType& endT = typeVec[rangeEnd];
 
@@ -187,7 +188,7 @@ void Lanes::setApplied()
     typeVec[activeLane] = LANE_APPLIED; // TODO test with boundaries
 }
 
-void Lanes::changeActiveLane(const QString& sha)
+void Lanes::changeActiveLane(const ObjectId& id)
 {
     LaneType& t = typeVec[activeLane];
     if (t == LANE_INITIAL || isBoundary(t))
@@ -195,11 +196,11 @@ void Lanes::changeActiveLane(const QString& sha)
     else
         t = LANE_NOT_ACTIVE;
 
-    int idx = findNextSha(sha, 0); // find first sha
+    int idx = findNextSha(id); // find first lane
     if (idx != -1)
         typeVec[idx] = LANE_ACTIVE; // called before setBoundary()
     else
-        idx = add(LANE_BRANCH, sha, activeLane); // new branch
+        idx = add(LANE_BRANCH, id, compact ? 0 : activeLane); // new branch
 
     activeLane = idx;
 }
@@ -209,7 +210,8 @@ void Lanes::afterMerge()
     if (boundary)
         return; // will be reset by changeActiveLane()
 
-    for (int i = 0; i < typeVec.count(); i++) {
+    // lanes out of merge range are untouched
+    for (int i = mergeStart; i <= mergeEnd; i++) {
 
         LaneType& t = typeVec[i];
 
@@ -226,7 +228,8 @@ void Lanes::afterMerge()
 
 void Lanes::afterFork()
 {
-    for (int i = 0; i < typeVec.count(); i++) {
+    // lanes out of fork range are untouched, merge ones are already reset
+    for (int i = forkStart; i <= forkEnd; i++) {
 
         LaneType& t = typeVec[i];
 
@@ -240,6 +243,7 @@ void Lanes::afterFork()
             t = LANE_ACTIVE; // boundary will be reset by changeActiveLane()
     }
     while (typeVec.last() == LANE_EMPTY) {
+        setNext(typeVec.count() - 1, ObjectId());
         typeVec.pop_back();
         nextShaVec.pop_back();
     }
@@ -260,17 +264,279 @@ void Lanes::afterApplied()
     typeVec[activeLane] = LANE_ACTIVE; // TODO test with boundaries
 }
 
-void Lanes::nextParent(const QString& sha)
+void Lanes::getLanes(QVector<LaneType>& ln)
 {
-    nextShaVec[activeLane] = (boundary ? "" : sha);
+    if (!compact) {
+        ln = typeVec; // O(1) vector is implicitly shared
+        return;
+    }
+    // in compact mode lanes are shown in the first MAX_COMPACT_LANES - 1
+    // columns, each one always in the same column, so that lines are not
+    // broken. When they are all taken, a lane that has been a plain line
+    // for FOLD_IDLE_ROWS rows is folded to make room for one with something
+    // to draw. Last column marks the folded lanes, or shows the active lane
+    // if there is no room for it, so rows have a bounded width however many
+    // branches are in parallel.
+    //
+    // All the other lanes are plain lines or empty as in previous row, so
+    // only the lanes changed by this row and the shown columns are visited
+    // and cost does not grow with the number of lanes
+    const int last = MAX_COMPACT_LANES - 1;
+    const int cnt = typeVec.count();
+    if (laneOfCol.isEmpty())
+        laneOfCol.fill(-1, last);
+
+    // a lane ends only after a row where it had something to draw
+    for (int i = 0; i < prevEvents.count(); i++) {
+        const int lane = prevEvents.at(i);
+        if (lane >= cnt || IS_GAP(typeVec.at(lane)))
+            hideLane(lane);
+    }
+    rowNum++;
+    touch(activeLane);
+    for (int i = 0; i < events.count(); i++)
+        lastEventRow[events.at(i)] = rowNum;
+
+    // columns are given in lanes order, after the active one
+    qSort(events);
+    showLane(activeLane, true);
+    for (int i = 0; i < events.count(); i++)
+        showLane(events.at(i), false);
+
+    bool foldedEvent = false;
+    for (int i = 0; i < events.count(); i++)
+        if (events.at(i) != activeLane && colOfLane.at(events.at(i)) == FOLDED)
+            foldedEvent = true;
+
+    int width = (foldedCnt > 0 ? MAX_COMPACT_LANES : 1);
+    for (int c = 0; c < last; c++)
+        if (laneOfCol.at(c) != -1)
+            width = qMax(width, c + 1);
+
+    ln.fill(LANE_EMPTY, width);
+    for (int c = 0; c < last && c < width; c++)
+        if (laneOfCol.at(c) != -1)
+            ln[c] = typeVec.at(laneOfCol.at(c));
+
+    const int activeCol = colOfLane.at(activeLane);
+    if (activeCol < 0)
+        ln[last] = typeVec.at(activeLane);
+    else if (foldedCnt > 0)
+        ln[last] = LANE_OVERFLOW;
+
+    drawRanges(ln, activeCol < 0 ? last : activeCol, foldedEvent ? last : -1);
+
+    prevEvents = events;
+    events.clear();
 }
 
-int Lanes::findNextSha(const QString& next, int pos)
+bool Lanes::isSameState(const Lanes& l) const
 {
-    for (int i = pos; i < nextShaVec.count(); i++)
-        if (nextShaVec[i] == next)
-            return i;
-    return -1;
+    // true if next rows are laid out the same by both, also when they come
+    // after a different number of rows. Ids of empty lanes are stale, and
+    // in compact mode only idle rows of shown lanes matter
+    if (typeVec.isEmpty() || l.typeVec.isEmpty())
+        return false; // not yet initialized
+
+    if (activeLane != l.activeLane || boundary != l.boundary
+        || compact != l.compact || typeVec != l.typeVec)
+        return false;
+
+    for (int i = 0; i < typeVec.count(); i++)
+        if (!IS_GAP(typeVec.at(i)) && nextShaVec.at(i) != l.nextShaVec.at(i))
+            return false;
+
+    if (!compact)
+        return true;
+
+    if (foldedCnt != l.foldedCnt || prevEvents != l.prevEvents || laneOfCol != l.laneOfCol)
+        return false;
+
+    const int cnt = qMax(colOfLane.count(), l.colOfLane.count());
+    for (int i = 0; i < cnt; i++) {
+        const int col = (i < colOfLane.count() ? colOfLane.at(i) : -1);
+        const int lCol = (i < l.colOfLane.count() ? l.colOfLane.at(i) : -1);
+        if (col != lCol)
+            return false;
+
+        if (col >= 0 && rowNum - lastEventRow.at(i) != l.rowNum - l.lastEventRow.at(i))
+            return false;
+    }
+    return true;
+}
+
+void Lanes::touch(int lane)
+{
+    // records a lane with something to draw in current row
+    if (!compact)
+        return;
+
+    const int oldCnt = colOfLane.count();
+    if (lane >= oldCnt) {
+        colOfLane.resize(lane + 1);
+        lastEventRow.resize(lane + 1);
+        for (int i = oldCnt; i <= lane; i++) {
+            colOfLane[i] = -1;
+            lastEventRow[i] = 0;
+        }
+    }
+    events.append(lane);
+}
+
+void Lanes::hideLane(int lane)
+{
+    // an empty lane frees its column, or is no more folded
+    const int col = colOfLane.at(lane);
+    if (col >= 0)
+        laneOfCol[col] = -1;
+    else if (col == FOLDED)
+        foldedCnt--;
+
+    colOfLane[lane] = -1;
+}
+
+void Lanes::showLane(int lane, bool force)
+{
+    const int oldCol = colOfLane.at(lane);
+    if (oldCol >= 0)
+        return;
+
+    const int col = freeColumn(lane, force);
+    if (col != -1) {
+        if (oldCol == FOLDED)
+            foldedCnt--;
+
+        colOfLane[lane] = col;
+        laneOfCol[col] = lane;
+
+    } else if (oldCol != FOLDED) {
+        colOfLane[lane] = FOLDED;
+        foldedCnt++;
+    }
+}
+
+int Lanes::freeColumn(int lane, bool force)
+{
+    // lane own column is preferred, so that narrow graphs are unchanged
+    const int last = MAX_COMPACT_LANES - 1;
+    if (lane < last && laneOfCol.at(lane) == -1)
+        return lane;
+
+    for (int c = 0; c < last; c++)
+        if (laneOfCol.at(c) == -1)
+            return c;
+
+    // all taken, fold the lane that is a plain line since longer, if idle
+    // enough, or in any case if 'force' is set. Lanes of current row have
+    // no idle rows, so they are never folded
+    int col = -1, maxIdle = (force ? 0 : FOLD_IDLE_ROWS - 1);
+    for (int c = 0; c < last; c++) {
+        const int idle = rowNum - lastEventRow.at(laneOfCol.at(c));
+        if (idle > maxIdle) {
+            maxIdle = idle;
+            col = c;
+        }
+    }
+    if (col != -1) {
+        colOfLane[laneOfCol.at(col)] = FOLDED;
+        foldedCnt++;
+    }
+    return col;
+}
+
+static LaneType sided(int side, LaneType t, LaneType tL, LaneType tR)
+{
+    // variant of 't' at the left end, at the right end or in the middle
+    return (side < 0 ? tL : (side > 0 ? tR : t));
+}
+
+void Lanes::drawRanges(QVector<LaneType>& ln, int nodeCol, int foldedCol) const
+{
+// shown columns could be in a different order than lanes, so horizontal
+// lines of forks and merges are drawn again, from the leftmost column of
+// their lanes to the rightmost one. Folded lanes are joined to 'foldedCol'
+
+    if (!IS_NODE(ln.at(nodeCol)))
+        return;
+
+    int first = nodeCol, end = nodeCol;
+    for (int c = 0; c < ln.count(); c++) {
+        const LaneType t = ln.at(c);
+        if (isHead(t) || isTail(t) || isJoin(t) || c == foldedCol) {
+            first = qMin(first, c);
+            end = qMax(end, c);
+        }
+    }
+    if (first < nodeCol && nodeCol < end)
+        ln[nodeCol] = NODE;
+    else if (nodeCol < end)
+        ln[nodeCol] = NODE_L;
+    else if (first < nodeCol)
+        ln[nodeCol] = NODE_R;
+
+    for (int c = 0; c < ln.count(); c++) {
+
+        LaneType& t = ln[c];
+        if (c == nodeCol)
+            continue;
+
+        if (c < first || c > end) {
+            if (t == LANE_CROSS)
+                t = LANE_NOT_ACTIVE;
+            else if (t == LANE_CROSS_EMPTY)
+                t = LANE_EMPTY;
+            continue;
+        }
+        const int side = (c == first ? -1 : (c == end ? 1 : 0));
+        if (isHead(t))
+            t = sided(side, LANE_HEAD, LANE_HEAD_L, LANE_HEAD_R);
+
+        else if (isTail(t))
+            t = sided(side, LANE_TAIL, LANE_TAIL_L, LANE_TAIL_R);
+
+        else if (isJoin(t))
+            t = sided(side, LANE_JOIN, LANE_JOIN_L, LANE_JOIN_R);
+
+        else if (side == 0 && t == LANE_NOT_ACTIVE)
+            t = LANE_CROSS;
+
+        else if (side == 0 && t == LANE_EMPTY)
+            t = LANE_CROSS_EMPTY;
+    }
+}
+
+void Lanes::nextParent(const ObjectId& id)
+{
+    setNext(activeLane, boundary ? ObjectId() : id);
+}
+
+int Lanes::findNextSha(const ObjectId& next, int* cnt) const
+{
+    // returns first lane expecting 'next', or -1, and optionally
+    // the number of lanes expecting it. Lanes of an id are few.
+    int first = -1, n = 0;
+    QMultiHash<ObjectId, int>::const_iterator it(nextShaLanes.constFind(next));
+    for ( ; it != nextShaLanes.constEnd() && it.key() == next; ++it, ++n)
+        if (first == -1 || it.value() < first)
+            first = it.value();
+
+    if (cnt)
+        *cnt = n;
+    return first;
+}
+
+void Lanes::setNext(int lane, const ObjectId& next)
+{
+    const ObjectId& prev = nextShaVec.at(lane);
+    if (prev == next)
+        return;
+
+    if (!prev.isNull())
+        nextShaLanes.remove(prev, lane);
+
+    nextShaVec[lane] = next;
+    if (!next.isNull())
+        nextShaLanes.insert(next, lane);
 }
 
 int Lanes::findType(LaneType type, int pos)
@@ -281,19 +547,20 @@ int Lanes::findType(LaneType type, int pos)
     return -1;
 }
 
-int Lanes::add(LaneType type, const QString& next, int pos)
+int Lanes::add(LaneType type, const ObjectId& next, int pos)
 {
     // first check empty lanes starting from pos
     if (pos < (int)typeVec.count()) {
         pos = findType(LANE_EMPTY, pos);
         if (pos != -1) {
             typeVec[pos] = type;
-            nextShaVec[pos] = next;
+            setNext(pos, next);
             return pos;
         }
     }
     // if all lanes are occupied add a new lane
     typeVec.append(type);
-    nextShaVec.append(next);
+    nextShaVec.append(ObjectId());
+    setNext(typeVec.count() - 1, next);
     return typeVec.count() - 1;
 }
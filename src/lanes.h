@@ -7,9 +7,9 @@
 #ifndef LANES_H
 #define LANES_H
 
-#include <QString>
+#include <QHash>
 #include <QVector>
-#include <QStringList>
+#include "model/objectid.h"
 
 // graph elements
 enum LaneType
@@ -40,12 +40,15 @@ enum LaneType
     LANE_BOUNDARY_C, // corresponds to MERGE_FORK
     LANE_BOUNDARY_R, // corresponds to MERGE_FORK_R
     LANE_BOUNDARY_L, // corresponds to MERGE_FORK_L
+    LANE_OVERFLOW,   // lanes folded in compact mode, see Lanes::getLanes()
 
     LANE_TYPES_NUM
 };
 //
 //  At any given time, the Lanes class represents a single revision (row) of the history graph.
-//  The Lanes class contains a vector of the sha1 hashes of the next commit to appear in each lane (column).
+//  The Lanes class contains a vector of the ids of the next commit to appear in each lane (column), and
+//  a small hash from each expected id to its lanes, so that a row costs O(parents) lookups instead of
+//  a scan of all the lanes.
 //  The Lanes class also contains a vector used to decide which glyph to draw on the history graph.
 //
 //  For each revision (row) (from recent (top) to ancient past (bottom)), the Lanes class is updated, and the
@@ -72,34 +75,62 @@ inline bool isActive(LaneType x) { return (x == LANE_ACTIVE || x == LANE_INITIAL
 class Lanes
 {
 public:
-    Lanes() {} // init() will setup us later, when data is available
+    enum {
+        MAX_COMPACT_LANES = 16, // shown lanes of a row in compact mode
+        FOLD_IDLE_ROWS = 50     // rows a lane must be a plain line to be folded
+    };
+
+    Lanes() : compact(false) {} // init() will setup us later, when data is available
     bool isEmpty() { return typeVec.empty(); }
-    void init(const QString& expectedSha);
+    void setCompact(bool b) { compact = b; } // not changed by clear()
+    void init(const ObjectId& expected);
     void clear();
-    bool isFork(const QString& sha, bool& isDiscontinuity);
+    bool isFork(const ObjectId& id, bool& isDiscontinuity);
     void setBoundary(bool isBoundary);
-    void setFork(const QString& sha);
-    void setMerge(const QStringList& parents);
+    void setFork(const ObjectId& id);
+    void setMerge(const QVector<ObjectId>& parents);
     void setInitial();
     void setApplied();
-    void changeActiveLane(const QString& sha);
+    void changeActiveLane(const ObjectId& id);
     void afterMerge();
     void afterFork();
     bool isBranch();
     void afterBranch();
     void afterApplied();
-    void nextParent(const QString &sha);
-    void getLanes(QVector<LaneType> &ln) { ln = typeVec; } // O(1) vector is implicitly shared
+    void nextParent(const ObjectId& id);
+    void getLanes(QVector<LaneType> &ln);
+    bool isSameState(const Lanes& l) const;
 
 private:
-    int findNextSha(const QString &next, int pos);
+    int findNextSha(const ObjectId& next, int* cnt = NULL) const;
     int findType(LaneType type, int pos);
-    int add(LaneType type, const QString &next, int pos);
+    int add(LaneType type, const ObjectId& next, int pos);
+    void setNext(int lane, const ObjectId& next);
+    void touch(int lane);
+    void hideLane(int lane);
+    void showLane(int lane, bool force);
+    int freeColumn(int lane, bool force);
+    void drawRanges(QVector<LaneType>& ln, int nodeCol, int foldedCol) const;
+
+    enum { FOLDED = -2 }; // in colOfLane, -1 is a lane without column
 
     int activeLane;
     QVector<LaneType> typeVec;  // Describes which glyphs should be drawn.
-    QVector<QString> nextShaVec;  // The sha1 hashes of the next commit to appear in each lane (column).
+    QVector<ObjectId> nextShaVec;  // The id of the next commit to appear in each lane (column), null if none.
+    QMultiHash<ObjectId, int> nextShaLanes; // The lanes of each id in nextShaVec.
     bool boundary;
+    int forkStart, forkEnd;   // lanes changed by setFork(), reset by afterFork()
+    int mergeStart, mergeEnd; // lanes changed by setMerge(), reset by afterMerge()
+
+    // compact mode only, lanes are shown in bounded columns, see getLanes()
+    bool compact; // reuse free lanes from the first one and fold the idle ones
+    int rowNum;               // rows laid out
+    int foldedCnt;            // folded lanes, empty ones are not counted
+    QVector<int> events;      // lanes with something to draw in current row
+    QVector<int> prevEvents;  // the ones of previous row
+    QVector<int> lastEventRow; // by lane, last row with something to draw
+    QVector<int> colOfLane;   // by lane, shown column, -1 or FOLDED
+    QVector<int> laneOfCol;   // by column, shown lane or -1 if free
     LaneType NODE, NODE_L, NODE_R;
 };
 
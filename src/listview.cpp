@@ -367,8 +367,8 @@ bool ListView::getLaneParentsChilds(SCRef sha, int x, SList p, SList c)
     ListViewDelegate* lvd = static_cast<ListViewDelegate*>(itemDelegate());
     uint lane = x / lvd->laneWidth();
     LaneType t = getLaneType(sha, lane);
-    if (t == LANE_EMPTY || t == -1)
-        return false;
+    if (t == LANE_EMPTY || t == LANE_OVERFLOW || t == -1)
+        return false; // folded lanes have no parent to show
 
     // first find the parents
     p.clear();
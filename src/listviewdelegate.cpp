@@ -1,11 +1,24 @@
 #include "listviewdelegate.h"
 
+#define PADDING  5 // left margin of the graph
+
 ListViewDelegate::ListViewDelegate(Git* g, ListViewProxy* px, QObject* p) : QItemDelegate(p)
 {
     git = g;
     lp = px;
     laneHeight = 0;
     diffTargetRow = -1;
+    glyphCache.setMaxCost(MAX_LANE_GLYPH_CACHE_SIZE);
+    rowCache.setMaxCost(MAX_LANE_ROW_CACHE_COST);
+}
+
+void ListViewDelegate::setLaneHeight(int h) {
+
+    if (laneHeight != h) {
+        laneHeight = h;
+        glyphCache.clear(); // tiles of the old size are never used again
+        rowCache.clear();
+    }
 }
 
 QSize ListViewDelegate::sizeHint(const QStyleOptionViewItem&, const QModelIndex&) const
@@ -46,8 +59,6 @@ static QColor blend(const QColor& col1, const QColor& col2, int amount = 128) {
 void ListViewDelegate::paintGraphLane(QPainter* p, int type, int x1, int x2,
                                       const QColor& col, const QColor& activeCol, const QBrush& back) const
 {
-    #define PADDING  5
-
     x1 += PADDING;
     x2 += PADDING;
 
@@ -211,6 +222,13 @@ void ListViewDelegate::paintGraphLane(QPainter* p, int type, int x1, int x2,
         p->setBrush(back);
         p->drawRect(R_CENTER);
         break;
+    case LANE_OVERFLOW:
+        // Dots, more lanes are folded here
+        p->setPen(Qt::NoPen);
+        p->setBrush(col);
+        for (int i = -1; i <= 1; i++)
+            p->drawRect(m + i * r - 1, h - 1, 2, 2);
+        break;
     default:
         break;
     }
@@ -228,7 +246,30 @@ void ListViewDelegate::paintGraphLane(QPainter* p, int type, int x1, int x2,
     #undef CENTER_UL
     #undef CENTER_DL
     #undef R_CENTER
-    #undef PADDING
+}
+
+const QPixmap* ListViewDelegate::laneGlyph(int type, const QColor& col,
+                                           const QColor& activeCol, const QBrush& back) const {
+
+    // antialiased paths are slow, so each lane tile is drawn once and
+    // then just copied, tile origin is at the left border of the lane
+    const int lw = laneWidth();
+    const int k[] = { type, (int)col.rgba(), (int)activeCol.rgba(),
+                      (int)back.color().rgba(), lw, laneHeight };
+    const QByteArray key((const char*)k, sizeof(k));
+
+    QPixmap* pm = glyphCache.object(key);
+    if (!pm) {
+        // room for padding and for the pen overflowing the lane borders
+        pm = new QPixmap(lw + PADDING + 2, laneHeight + 1);
+        pm->fill(Qt::transparent);
+        QPainter gp(pm);
+        gp.setRenderHints(QPainter::Antialiasing);
+        paintGraphLane(&gp, type, 0, lw, col, activeCol, back);
+        gp.end();
+        glyphCache.insert(key, pm);
+    }
+    return pm;
 }
 
 void ListViewDelegate::paintGraph(QPainter* p, const QStyleOptionViewItem& opt,
@@ -237,28 +278,31 @@ void ListViewDelegate::paintGraph(QPainter* p, const QStyleOptionViewItem& opt,
     static const QColor colors[COLORS_NUM] = { Qt::red, DARK_GREEN,
                                                Qt::blue, Qt::darkGray, BROWN,
                                                Qt::magenta, ORANGE };
-    if (opt.state & QStyle::State_Selected)
-        p->fillRect(opt.rect, opt.palette.highlight());
-    else if (i.row() & 1)
-        p->fillRect(opt.rect, opt.palette.alternateBase());
-    else
-        p->fillRect(opt.rect, opt.palette.base());
+    const bool selected = (opt.state & QStyle::State_Selected);
+    const QBrush fill = selected ? opt.palette.highlight()
+                      : (i.row() & 1) ? opt.palette.alternateBase() : opt.palette.base();
 
     FileHistory* fh;
     const Revision* r = revLookup(i.row(), &fh);
-    if (!r)
+    if (!r) {
+        p->fillRect(opt.rect, fill);
         return;
-
-    p->save();
-    p->setClipRect(opt.rect, Qt::IntersectClip);
-    p->translate(opt.rect.topLeft());
-
+    }
     // calculate lanes
     if (r->lanes.count() == 0)
         git->setLane(r->sha(), fh);
 
     QBrush back = opt.palette.base();
-    const QVector<LaneType>& lanes(r->lanes);
+    if (r->lanes.count() == 0) { // still being built in background
+        p->fillRect(opt.rect, fill);
+        p->save();
+        p->setClipRect(opt.rect, Qt::IntersectClip);
+        p->drawPixmap(opt.rect.topLeft(), *laneGlyph(LANE_NOT_ACTIVE, Qt::lightGray,
+                                                     Qt::lightGray, back));
+        p->restore();
+        return;
+    }
+    const PackedLanes& lanes(r->lanes);
     uint laneNum = lanes.count();
     uint activeLane = 0;
     for (uint i = 0; i < laneNum; i++)
@@ -267,25 +311,46 @@ void ListViewDelegate::paintGraph(QPainter* p, const QStyleOptionViewItem& opt,
             break;
         }
 
-    int x1 = 0, x2 = 0;
-    int maxWidth = opt.rect.width();
-    int lw = laneWidth();
     QColor activeColor = colors[activeLane % COLORS_NUM];
-    if (opt.state & QStyle::State_Selected)
+    if (selected)
         activeColor = blend(activeColor, opt.palette.highlightedText().color(), 208);
-    for (uint i = 0; i < laneNum && x2 < maxWidth; i++) {
-
-        x1 = x2;
-        x2 += lw;
 
-        int ln = lanes[i];
-        if (ln == LANE_EMPTY)
-            continue;
+    // many rows share the same lanes, so when scrolling a whole cell is
+    // usually found already drawn and is just copied on screen
+    QByteArray key(lanes.packed());
+    const int k[] = { (int)fill.color().rgba(), (int)activeColor.rgba(),
+                      (int)back.color().rgba(), opt.rect.width(), opt.rect.height() };
+    key.append(QByteArray::fromRawData((const char*)k, sizeof(k)));
+
+    QPixmap* pm = rowCache.object(key);
+    if (!pm) {
+        pm = new QPixmap(opt.rect.size());
+        pm->fill(fill.color());
+        QPainter rp(pm);
+
+        int x1 = 0, x2 = 0;
+        int maxWidth = opt.rect.width();
+        int lw = laneWidth();
+        for (uint i = 0; i < laneNum && x2 < maxWidth; i++) {
+
+            x1 = x2;
+            x2 += lw;
+
+            int ln = lanes[i];
+            if (ln == LANE_EMPTY)
+                continue;
+
+            QColor color = i == activeLane ? activeColor : colors[i % COLORS_NUM];
+            rp.drawPixmap(x1, 0, *laneGlyph(ln, color, activeColor, back));
+        }
+        rp.end();
 
-        QColor color = i == activeLane ? activeColor : colors[i % COLORS_NUM];
-        paintGraphLane(p, ln, x1, x2, color, activeColor, back);
+        // drawn before caching, a too big cell is deleted by insert()
+        p->drawPixmap(opt.rect.topLeft(), *pm);
+        rowCache.insert(key, pm, pm->width() * pm->height());
+        return;
     }
-    p->restore();
+    p->drawPixmap(opt.rect.topLeft(), *pm);
 }
 
 void ListViewDelegate::paintLog(QPainter* p, const QStyleOptionViewItem& opt,
@@ -324,8 +389,6 @@ void ListViewDelegate::paintLog(QPainter* p, const QStyleOptionViewItem& opt,
 void ListViewDelegate::paint(QPainter* p, const QStyleOptionViewItem& opt,
                              const QModelIndex& index) const {
 
-  p->setRenderHints(QPainter::Antialiasing);
-
     if (index.column() == GRAPH_COL)
         return paintGraph(p, opt, index);
 
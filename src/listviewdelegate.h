@@ -1,6 +1,7 @@
 #ifndef LISTVIEWDELEGATE_H
 #define LISTVIEWDELEGATE_H
 
+#include <QCache>
 #include <QItemDelegate>
 #include "git.h"
 #include "listviewproxy.h"
@@ -17,7 +18,7 @@ public:
     virtual void paint(QPainter* p, const QStyleOptionViewItem& o, const QModelIndex &i) const;
     virtual QSize sizeHint(const QStyleOptionViewItem& o, const QModelIndex &i) const;
     int laneWidth() const { return 3 * laneHeight / 4; }
-    void setLaneHeight(int h) { laneHeight = h; }
+    void setLaneHeight(int h);
 
 signals:
     void updateView();
@@ -31,6 +32,8 @@ private:
     void paintGraph(QPainter* p, const QStyleOptionViewItem& o, const QModelIndex &i) const;
     void paintGraphLane(QPainter* p, int type, int x1, int x2, const QColor& col,
                         const QColor& activeCol, const QBrush& back) const;
+    const QPixmap* laneGlyph(int type, const QColor& col, const QColor& activeCol,
+                             const QBrush& back) const;
     QPixmap* getTagMarks(SCRef sha, const QStyleOptionViewItem& opt) const;
     void addRefPixmap(QPixmap** pp, SCRef sha, int type, QStyleOptionViewItem opt) const;
     void addTextPixmap(QPixmap** pp, SCRef txt, const QStyleOptionViewItem& opt) const;
@@ -40,6 +43,8 @@ private:
     ListViewProxy* lp;
     int laneHeight;
     int diffTargetRow;
+    mutable QCache<QByteArray, QPixmap> glyphCache; // antialiased lane tiles
+    mutable QCache<QByteArray, QPixmap> rowCache; // whole graph cells, by lanes and colors
 };
 
 #endif // LISTVIEWDELEGATE_H
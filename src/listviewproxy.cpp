@@ -28,7 +28,7 @@ bool ListViewProxy::isMatch(SCRef sha) const {
     else if (colNum == AUTH_COL)
         target = r->author();
     else if (colNum == LOG_MSG_COL)
-        target = r->longLog();
+        target = git->getLongLog(r);
     else if (colNum == COMMIT_COL)
         target = sha;
 
@@ -66,6 +66,10 @@ int ListViewProxy::setFilter(bool isOn, bool h, SCRef fl, int cn, ShaSet* s) {
     if (s)
         shaSet = *s;
 
+    // log messages could be not in memory, see Git::grepLongLogs()
+    if (isOn && cn == LOG_MSG_COL && git->grepLongLogs(d->model(), fl, shaSet))
+        colNum = SHA_MAP_COL;
+
     // isHighlighted() is called also when filter is off,
     // so reset 'isHighLight' flag in that case
     isHighLight = h && isOn;
@@ -0,0 +1,95 @@
+/*
+    Description: main history loading statistics
+
+    Author: Marco Costalba (C) 2005-2007
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include <QFile>
+#include <QTextStream>
+#include <QTime>
+#ifndef Q_OS_WIN32
+#include <sys/time.h>
+#endif
+#include "loadstats.h"
+
+void LoadStats::reset()
+{
+    for (int i = 0; i < PHASES_NUM; i++)
+        times[i] = calls[i] = 0;
+
+    bytes = 0;
+    revs = 0;
+}
+
+qint64 LoadStats::now()
+{
+#ifndef Q_OS_WIN32
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (qint64)tv.tv_sec * 1000000 + tv.tv_usec;
+#else
+    // milliseconds resolution is the best we have with Qt4 only
+    static const QTime start(QTime::currentTime());
+    return (qint64)start.msecsTo(QTime::currentTime()) * 1000;
+#endif
+}
+
+const char* LoadStats::phaseName(Phase p)
+{
+    static const char* names[PHASES_NUM] = {
+        "spawn", "firstData", "git", "parse", "insert",
+        "model", "lanes", "indexTree", "total"
+    };
+    return names[p];
+}
+
+const QString LoadStats::toString() const
+{
+    QString s;
+    QTextStream ts(&s);
+    ts << "Revisions: " << revs << "\n";
+    ts << "Bytes read: " << bytes << "\n";
+
+    for (int i = 0; i < PHASES_NUM; i++) {
+        QString line;
+        line.sprintf("%-10s %10.1f ms  %8i calls",
+                     phaseName((Phase)i), times[i] / 1000.0, calls[i]);
+        ts << "\n" << line;
+    }
+    if (times[TOTAL] > 0) {
+        QString line;
+        line.sprintf("%.2f MB/s, %.0f revs/s", (double)bytes / times[TOTAL],
+                     revs * 1000000.0 / times[TOTAL]);
+        ts << "\n\n" << line;
+    }
+    return s;
+}
+
+const QByteArray LoadStats::toJson() const
+{
+    QString s;
+    QTextStream ts(&s);
+    ts << "{\n  \"revisions\": " << revs << ",\n";
+    ts << "  \"bytes\": " << bytes << ",\n";
+    ts << "  \"phases\": {";
+    for (int i = 0; i < PHASES_NUM; i++) {
+        ts << (i ? ",\n" : "\n") << "    \"" << phaseName((Phase)i) << "\": { "
+           << "\"usecs\": " << times[i] << ", \"calls\": " << calls[i] << " }";
+    }
+    ts << "\n  }\n}\n";
+    ts.flush();
+    return s.toLatin1();
+}
+
+bool LoadStats::saveJson(SCRef path) const
+{
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        dbp("ERROR unable to save loading statistics to %1", path);
+        return false;
+    }
+    const QByteArray json(toJson());
+    return f.write(json) == json.size();
+}
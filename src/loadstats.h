@@ -0,0 +1,57 @@
+/*
+    Author: Marco Costalba (C) 2005-2007
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#ifndef LOADSTATS_H
+#define LOADSTATS_H
+
+#include "common.h"
+
+/*
+   Timings of main history loading, split by phase
+
+   Everything is in microseconds and summed over all the loading rounds,
+   so to tell if a slow loading is due to git, to our parser or to the
+   view. Shown in the "Load statistics" dock and, if environment variable
+   QGIT_LOAD_STATS is set, saved as JSON in the file it names at exit.
+*/
+class LoadStats
+{
+public:
+    enum Phase {
+        SPAWN,      // starting git processes
+        FIRST_DATA, // from git start to first data received
+        GIT,        // from git start to git exit
+        PARSE,      // splitting and indexing records, in parser thread
+        INSERT,     // adding parsed revisions to history
+        MODEL,      // updating model and views with new rows
+        LANES,      // computing graph lanes
+        INDEX_TREE, // indexing refs and children after loading
+        TOTAL,      // whole loading, as reported in status bar
+        PHASES_NUM
+    };
+
+    LoadStats() { reset(); }
+    void reset();
+    void add(Phase p, qint64 usecs) { times[p] += usecs; calls[p]++; }
+    void addBytes(qint64 b) { bytes += b; }
+    void setRevs(int cnt) { revs = cnt; }
+    const QString toString() const;
+    const QByteArray toJson() const;
+    bool saveJson(SCRef path) const;
+
+    //! Microseconds from an arbitrary point, callable from any thread
+    static qint64 now();
+
+private:
+    static const char* phaseName(Phase p);
+
+    qint64 times[PHASES_NUM];
+    int calls[PHASES_NUM];
+    qint64 bytes;
+    int revs;
+};
+
+#endif
@@ -7,8 +7,10 @@
 
 */
 #include <QCloseEvent>
+#include <QDockWidget>
 #include <QDrag>
 #include <QEvent>
+#include <QFile>
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QMenu>
@@ -121,6 +123,19 @@ MainImpl::MainImpl(SCRef cd, QWidget *parent) : QMainWindow(parent)
     pbFileNamesLoading->hide();
     statusBar()->addPermanentWidget(pbFileNamesLoading);
 
+    // set-up loading statistics dock, for profiling, hidden by default
+    loadStatsDock = new QDockWidget("Load statistics", this);
+    loadStatsDock->setObjectName("loadStatsDock");
+    loadStatsText = new QTextEdit(loadStatsDock);
+    loadStatsText->setReadOnly(true);
+    loadStatsText->setLineWrapMode(QTextEdit::NoWrap);
+    loadStatsText->setFont(QGit::TYPE_WRITER_FONT);
+    loadStatsDock->setWidget(loadStatsText);
+    addDockWidget(Qt::BottomDockWidgetArea, loadStatsDock);
+    loadStatsDock->hide();
+    View->addSeparator();
+    View->addAction(loadStatsDock->toggleViewAction());
+
     QVector<QSplitter*> v(1, treeSplitter);
     QGit::restoreGeometrySetting(QGit::MAIN_GEOM_KEY, this, &v);
 
@@ -145,11 +160,16 @@ MainImpl::MainImpl(SCRef cd, QWidget *parent) : QMainWindow(parent)
 
     connect(git, SIGNAL(fileNamesLoad(int, int)), this, SLOT(fileNamesLoad(int, int)));
 
-    connect(git, SIGNAL(newRevsAdded(const FileHistory*, const QVector<ShaString>&)),
-            this, SLOT(newRevsAdded(const FileHistory*, const QVector<ShaString>&)));
+    connect(git, SIGNAL(loadStatsChanged()), this, SLOT(loadStatsChanged()));
+
+    connect(git, SIGNAL(newRevsAdded(const FileHistory*, const QVector<ObjectId>&)),
+            this, SLOT(newRevsAdded(const FileHistory*, const QVector<ObjectId>&)));
 
     connect(this, SIGNAL(typeWriterFontChanged()), this, SIGNAL(updateRevDesc()));
 
+    // near tags and descendant branches are known only now
+    connect(git, SIGNAL(treeIndexed()), this, SIGNAL(updateRevDesc()));
+
     connect(this, SIGNAL(changeFont(const QFont&)), git, SIGNAL(changeFont(const QFont&)));
 
     // connect cross-domain update signals
@@ -389,6 +409,17 @@ void MainImpl::setRepository(SCRef newDir, bool refresh, bool keepSelection,
         if (archiveChanged && refresh)
             dbs("ASSERT in setRepository: different dir with no range select");
 
+        // on a plain refresh try to load only new revisions, current
+        // ones are kept and shown until new ones are added on top
+        if (   refresh && keepSelection && !archiveChanged && passedArgs == NULL
+            && git->refreshIncrementally()) { // blocking call
+
+            branchesTree->update(); // refs could be changed
+            setRepositoryBusy = false;
+            EM_REMOVE(exExiting);
+            return;
+        }
+
         // now we can clear all our data
         setWindowTitle(curDir + " - QGit");
         bool complete = !refresh || !keepSelection;
@@ -715,7 +746,7 @@ void MainImpl::revisionsDropped(SCList remoteRevs)
 
 // ******************************* Filter ******************************
 
-void MainImpl::newRevsAdded(const FileHistory* fh, const QVector<ShaString>&)
+void MainImpl::newRevsAdded(const FileHistory* fh, const QVector<ObjectId>&)
 {
     if (!git->isMainHistory(fh))
         return;
@@ -1137,6 +1168,11 @@ void MainImpl::fileNamesLoad(int status, int value)
     }
 }
 
+void MainImpl::loadStatsChanged()
+{
+    loadStatsText->setPlainText(git->getLoadStats().toString());
+}
+
 // ****************************** Menu *********************************
 
 void MainImpl::updateCommitMenu(bool isStGITStack)
@@ -1919,6 +1955,11 @@ void MainImpl::closeEvent(QCloseEvent* ce)
         return;
     }
 
+    // loading statistics of last repository, for profiling
+    const QByteArray statsFile(qgetenv("QGIT_LOAD_STATS"));
+    if (!statsFile.isEmpty())
+        git->getLoadStats().saveJson(QFile::decodeName(statsFile));
+
     emit closeAllTabs();
     delete rv;
     QWidget::closeEvent(ce);
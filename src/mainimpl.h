@@ -19,6 +19,7 @@
 class QAction;
 class QCloseEvent;
 class QComboBox;
+class QDockWidget;
 class QEvent;
 class QListWidgetItem;
 class QModelIndex;
@@ -71,8 +72,9 @@ signals:
 
 private slots:
     void tabWdg_currentChanged(int);
-    void newRevsAdded(const FileHistory*, const QVector<ShaString>&);
+    void newRevsAdded(const FileHistory*, const QVector<ObjectId>&);
     void fileNamesLoad(int, int);
+    void loadStatsChanged();
     void revisionsDragged(const QStringList&);
     void revisionsDropped(const QStringList&);
     void shortCutActivated();
@@ -171,6 +173,8 @@ private:
     Git* git;
     RevsView* rv;
     QProgressBar* pbFileNamesLoading;
+    QDockWidget* loadStatsDock;
+    QTextEdit* loadStatsText;
 
     // Actions for searching in branchesTree
     QAction *showSearchBranchLineEditAction;
@@ -0,0 +1,89 @@
+#include <QByteArray>
+#include <QtAlgorithms>
+#include "delimitertable.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DELIM_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DELIM_SSE2
+#endif
+
+static inline int lowestBit(unsigned int m)
+{
+#ifdef __GNUC__
+    return __builtin_ctz(m);
+#else
+    int n = 0;
+    while (!(m & 1)) {
+        m >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+void DelimiterTable::append(unsigned int mask, int base)
+{
+    while (mask) {
+        ofs.append(base + lowestBit(mask));
+        mask &= mask - 1; // clear lowest set bit
+    }
+}
+
+void DelimiterTable::scan(const char* data, int len)
+{
+    ofs.clear();
+    ofs.reserve(len / 32); // a guess, about two lines every 64 bytes
+    dataLen = len;
+    int i = 0;
+
+#if defined(DELIM_AVX2)
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+
+    for ( ; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, nl), _mm256_cmpeq_epi8(v, zero));
+        append((unsigned int)_mm256_movemask_epi8(m), i);
+    }
+#elif defined(DELIM_SSE2)
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+
+    for ( ; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, zero));
+        append((unsigned int)_mm_movemask_epi8(m), i);
+    }
+#endif
+    // scalar tail, or the whole buffer without SIMD support
+    for ( ; i < len; i++)
+        if (data[i] == '\n' || data[i] == '\0')
+            ofs.append(i);
+}
+
+int DelimiterTable::indexOf(const char* data, char c, int from) const
+{
+    QVector<int>::const_iterator it = qLowerBound(ofs.constBegin(), ofs.constEnd(), from);
+
+    for ( ; it != ofs.constEnd(); ++it)
+        if (data[*it] == c)
+            return *it;
+
+    return -1;
+}
+
+int DelimiterTable::indexOf(const char* data, const char* line, int from) const
+{
+    // 'line' must start with '\n', as example "\ndiff "
+    const int len = (int)qstrlen(line);
+    QVector<int>::const_iterator it = qLowerBound(ofs.constBegin(), ofs.constEnd(), from);
+
+    for ( ; it != ofs.constEnd() && *it + len <= dataLen; ++it)
+        if (!qstrncmp(data + *it, line, (uint)len))
+            return *it;
+
+    return -1;
+}
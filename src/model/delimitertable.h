@@ -0,0 +1,32 @@
+#ifndef DELIMITERTABLE_H
+#define DELIMITERTABLE_H
+
+#include <QVector>
+
+//! Offsets of all '\n' and '\0' bytes of a 'git log' buffer
+/*!
+    Buffer is scanned once, 16 or 32 bytes at a time when SSE2 or AVX2
+    are available at compile time, then Revision::indexData() looks up
+    the record boundaries here instead of searching the bytes again.
+
+    Table must be rebuilt whenever the scanned buffer changes, with the
+    exception of the '\0' fixups written by indexData() in sha lines,
+    lookups always check the current byte value.
+*/
+class DelimiterTable
+{
+public:
+    DelimiterTable() : dataLen(0) {}
+    void scan(const char* data, int len);
+    int indexOf(const char* data, char c, int from) const;
+    int indexOf(const char* data, const char* line, int from) const;
+    int count() const { return ofs.count(); }
+
+private:
+    void append(unsigned int mask, int base);
+
+    QVector<int> ofs;
+    int dataLen;
+};
+
+#endif // DELIMITERTABLE_H
@@ -0,0 +1,64 @@
+#include <string.h>
+#include "lanestore.h"
+
+const PackedLanes LaneStore::intern(const QVector<LaneType>& lanes)
+{
+    const int cnt = qMin(lanes.count(), 0xFFFF);
+    if (cnt == 0)
+        return PackedLanes();
+
+    // count, packed lanes and a padding byte, see PackedLanes::at()
+    const int size = 2 + (cnt * 5 + 7) / 8 + 1;
+    QByteArray key(size, 0);
+    uchar* k = reinterpret_cast<uchar*>(key.data());
+    k[0] = (uchar)(cnt & 0xFF);
+    k[1] = (uchar)(cnt >> 8);
+
+    for (int i = 0; i < cnt; i++) {
+        const int bit = i * 5;
+        const uint v = ((uint)lanes.at(i) & 0x1F) << (bit & 7);
+        k[2 + (bit >> 3)] |= (uchar)(v & 0xFF);
+        k[3 + (bit >> 3)] |= (uchar)(v >> 8);
+    }
+    QMutexLocker locker(&mutex);
+
+    if (key == lastKey)
+        return PackedLanes(last);
+
+    const uchar* d = layouts.value(key);
+    if (!d) {
+        uchar* p = allocate(size);
+        memcpy(p, k, size);
+        d = p;
+        // key is not copied, stored layout is used instead
+        layouts.insert(QByteArray::fromRawData((const char*)d, size), d);
+    }
+    lastKey = key;
+    last = d;
+    return PackedLanes(d);
+}
+
+uchar* LaneStore::allocate(int size)
+{
+    if (used + size > BLOCK_SIZE) {
+        blocks.append(new uchar[BLOCK_SIZE]);
+        used = 0;
+    }
+    uchar* p = blocks.last() + used;
+    used += size;
+    return p;
+}
+
+void LaneStore::clear()
+{
+    // all the PackedLanes of this store become invalid
+    QMutexLocker locker(&mutex);
+
+    layouts.clear();
+    lastKey.clear();
+    for (int i = 0; i < blocks.count(); i++)
+        delete[] blocks.at(i);
+
+    blocks.clear();
+    used = BLOCK_SIZE;
+}
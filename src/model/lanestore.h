@@ -0,0 +1,86 @@
+#ifndef LANESTORE_H
+#define LANESTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QVector>
+#include "lanes.h"
+
+//! Graph lanes of a row, stored in a LaneStore
+/*!
+    Just a pointer to a lane count followed by the lane types packed in
+    5 bits each, shared by all the rows with the same lanes. Cheap to
+    copy, valid until the LaneStore is cleared.
+*/
+class PackedLanes
+{
+public:
+    PackedLanes() : d(NULL) {}
+    void clear() { d = NULL; }
+    bool isEmpty() const { return !d; }
+    int count() const { return d ? (d[0] | (d[1] << 8)) : 0; }
+    LaneType at(int i) const;
+    LaneType operator[](int i) const { return at(i); }
+    const QByteArray packed() const; // a copy, usable as a key
+
+private:
+    friend class LaneStore;
+
+    explicit PackedLanes(const uchar* data) : d(data) {}
+
+    const uchar* d;
+};
+
+inline LaneType PackedLanes::at(int i) const
+{
+    // a padding byte at the end makes reading two bytes always safe
+    const int bit = i * 5;
+    const uchar* p = d + 2 + (bit >> 3);
+    return (LaneType)(((p[0] | (p[1] << 8)) >> (bit & 7)) & 0x1F);
+}
+
+inline const QByteArray PackedLanes::packed() const
+{
+    const int cnt = count();
+    return cnt ? QByteArray((const char*)d, 2 + (cnt * 5 + 7) / 8) : QByteArray();
+}
+
+//! Storage of the graph lanes of a history
+/*!
+    Lanes of each row are packed and hash-consed, so that each layout
+    is stored once however many rows share it, and consecutive identical
+    rows, the common case, do not even need an hash lookup. A history
+    of 1M rows and 50 lanes takes a few MB instead of hundreds.
+
+    Interning is thread safe, lanes are computed by the LaneBuilder
+    thread too, and stored layouts are never changed or freed until
+    clear(), so they can be read without locking.
+*/
+class LaneStore
+{
+public:
+    LaneStore() : used(BLOCK_SIZE), last(NULL) {}
+    ~LaneStore() { clear(); }
+    const PackedLanes intern(const QVector<LaneType>& lanes);
+    void clear();
+
+private:
+    // prevent implicit C++ compiler defaults
+    LaneStore(const LaneStore&);
+    LaneStore& operator=(const LaneStore&);
+
+    enum { BLOCK_SIZE = 64 * 1024 };
+
+    uchar* allocate(int size);
+
+    QMutex mutex;
+    QList<uchar*> blocks;
+    int used; // of last block
+    QHash<QByteArray, const uchar*> layouts; // keys point into blocks
+    QByteArray lastKey;
+    const uchar* last;
+};
+
+#endif // LANESTORE_H
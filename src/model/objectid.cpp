@@ -0,0 +1,68 @@
+#include "objectid.h"
+
+static inline int hexVal(uchar c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+ObjectId::ObjectId(const ShaString& sha) : var(NULL_ID)
+{
+    memset(bytes, 0, sizeof(bytes));
+    const char* hex = sha.latin1();
+    if (hex)
+        parse(hex, 40); // stops at first non hex char, as a '\0'
+}
+
+ObjectId::ObjectId(const QString& sha) : var(NULL_ID)
+{
+    memset(bytes, 0, sizeof(bytes));
+    if (sha.length() == 40) {
+        const QByteArray ba(sha.toLatin1());
+        parse(ba.constData(), 40);
+    }
+}
+
+ObjectId ObjectId::fromRaw(const uchar* raw)
+{
+    ObjectId id;
+    memcpy(id.bytes, raw, sizeof(id.bytes));
+    id.var = PLAIN_ID;
+    return id;
+}
+
+void ObjectId::parse(const char* hex, int len)
+{
+    // on error we are left with a null id
+    const uchar* ch = reinterpret_cast<const uchar*>(hex);
+    for (int i = 0; i < len; i += 2) {
+        int hi = hexVal(ch[i]);
+        int lo = (hi != -1 ? hexVal(ch[i + 1]) : -1);
+        if (lo == -1) {
+            memset(bytes, 0, sizeof(bytes));
+            return;
+        }
+        bytes[i / 2] = (uchar)((hi << 4) | lo);
+    }
+    var = PLAIN_ID;
+}
+
+const QString ObjectId::toString() const
+{
+    static const char digits[] = "0123456789abcdef";
+
+    if (isNull())
+        return QString();
+
+    char hex[40];
+    for (int i = 0; i < 20; i++) {
+        hex[2 * i] = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 15];
+    }
+    return QString::fromLatin1(hex, 40);
+}
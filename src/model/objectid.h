@@ -0,0 +1,69 @@
+#ifndef OBJECTID_H
+#define OBJECTID_H
+
+#include <QString>
+#include <string.h>
+#include "shastring.h"
+
+//! Binary object id, the 20 bytes of a SHA-1
+/*!
+    Used as key of revisions, files, references and annotations maps,
+    text form is converted only when reading git output or displaying.
+
+    Digest bytes are already uniformly distributed, so the first 8 of
+    them are used as is as the 64 bit hash, there is nothing to compute
+    or to store in addition. Equality is a memcmp().
+
+    Some maps use also special keys that are not git objects, they are
+    the same id with a variant tag, see Variant.
+*/
+class ObjectId
+{
+public:
+    enum Variant {
+        NULL_ID         = -3, // default constructed, not a valid id
+        CUSTOM_ID       = -2, // files of a custom diff, see Git::getFiles()
+        MERGE_FILES_ID  = -1, // all merge files of a commit
+        PLAIN_ID        =  0  // a git object, > 0 is n-th parent of a split merge
+    };
+
+    ObjectId() : var(NULL_ID) { memset(bytes, 0, sizeof(bytes)); }
+    ObjectId(const ShaString& sha); // implicit, text form is the common input
+    explicit ObjectId(const QString& sha);
+    ObjectId(const ObjectId& id, int variant) : var(variant) { memcpy(bytes, id.bytes, sizeof(bytes)); }
+
+    static ObjectId custom() { return ObjectId(ObjectId(), CUSTOM_ID); }
+    static ObjectId fromRaw(const uchar* raw);
+
+    bool isNull() const { return var == NULL_ID; }
+    int variant() const { return var; }
+    const uchar* raw() const { return bytes; }
+    const QString toString() const;
+    quint64 hash64() const;
+
+    bool operator==(const ObjectId& o) const {
+        return var == o.var && !memcmp(bytes, o.bytes, sizeof(bytes));
+    }
+    bool operator!=(const ObjectId& o) const { return !operator==(o); }
+
+private:
+    void parse(const char* hex, int len);
+
+    uchar bytes[20];
+    qint32 var;
+};
+
+inline quint64 ObjectId::hash64() const
+{
+    quint64 h;
+    memcpy(&h, bytes, sizeof(h)); // unaligned safe
+    return h ^ ((quint64)(quint32)var * Q_UINT64_C(0x9E3779B97F4A7C15));
+}
+
+inline uint qHash(const ObjectId& id)
+{
+    const quint64 h = id.hash64();
+    return (uint)(h ^ (h >> 32));
+}
+
+#endif // OBJECTID_H
@@ -0,0 +1,137 @@
+#include <limits.h>
+#include "reachindex.h"
+
+void ReachIndex::clear()
+{
+    links = RevGraph::Links();
+    gen.clear();
+    pre.clear();
+    post.clear();
+    marks.clear();
+    stack.clear();
+    stamp = 0;
+}
+
+bool ReachIndex::build(const RevGraph::Links& l)
+{
+    // returns false, leaving the index empty, if rows are not in
+    // topological order, as example when loading with a custom order
+    clear();
+    const int cnt = l.count();
+    QVector<int> g(cnt, 1);
+
+    for (int row = cnt - 1; row >= 0; row--)
+        for (int i = l.parentOfs.at(row); i < l.parentOfs.at(row + 1); i++) {
+
+            const int p = l.parentRows.at(i);
+            if (p == -1)
+                continue;
+
+            if (p <= row)
+                return false;
+
+            g[row] = qMax(g.at(row), g.at(p) + 1);
+        }
+
+    // children along first parents, laid out back to back
+    QVector<int> ofs(cnt + 1, 0);
+    for (int row = 0; row < cnt; row++)
+        if (l.parentOfs.at(row) != l.parentOfs.at(row + 1)) {
+            const int p = l.parentRows.at(l.parentOfs.at(row));
+            if (p != -1)
+                ofs[p + 1]++;
+        }
+    for (int row = 0; row < cnt; row++)
+        ofs[row + 1] += ofs.at(row);
+
+    QVector<int> fillPos(ofs);
+    QVector<int> treeChilds(ofs.at(cnt));
+    for (int row = cnt - 1; row >= 0; row--)
+        if (l.parentOfs.at(row) != l.parentOfs.at(row + 1)) {
+            const int p = l.parentRows.at(l.parentOfs.at(row));
+            if (p != -1)
+                treeChilds[fillPos[p]++] = row;
+        }
+
+    // iterative depth first visit from roots, rows without a first parent
+    QVector<int> pr(cnt), po(cnt);
+    QVector<int> next(ofs); // next child to visit, by row
+    int counter = 0;
+    stack.reserve(64);
+
+    for (int root = cnt - 1; root >= 0; root--) {
+
+        const bool hasParent = (l.parentOfs.at(root) != l.parentOfs.at(root + 1)
+                                && l.parentRows.at(l.parentOfs.at(root)) != -1);
+        if (hasParent)
+            continue;
+
+        pr[root] = counter++;
+        stack.append(root);
+
+        while (!stack.isEmpty()) {
+
+            const int v = stack.last();
+            if (next.at(v) < ofs.at(v + 1)) {
+                const int c = treeChilds.at(next[v]++);
+                pr[c] = counter++;
+                stack.append(c);
+            } else {
+                po[v] = counter++;
+                stack.remove(stack.count() - 1);
+            }
+        }
+    }
+    links = l;
+    gen = g;
+    pre = pr;
+    post = po;
+    marks.fill(0, cnt);
+    return true;
+}
+
+bool ReachIndex::isAncestor(int anc, int row) const
+{
+    // true if 'anc' can be reached from 'row' following parents
+    if (anc == row)
+        return true;
+
+    if (anc < row || gen.at(anc) >= gen.at(row))
+        return false;
+
+    if (isTreeAncestor(anc, row))
+        return true;
+
+    if (stamp == INT_MAX) {
+        marks.fill(0);
+        stamp = 0;
+    }
+    stamp++;
+    stack.clear();
+    stack.append(row);
+    marks[row] = stamp;
+
+    while (!stack.isEmpty()) {
+
+        const int v = stack.last();
+        stack.remove(stack.count() - 1);
+
+        for (int i = links.parentOfs.at(v); i < links.parentOfs.at(v + 1); i++) {
+
+            const int p = links.parentRows.at(i);
+            if (p == anc)
+                return true;
+
+            // rows after 'anc' or not younger than it cannot reach it
+            if (p == -1 || p > anc || gen.at(p) <= gen.at(anc) || marks.at(p) == stamp)
+                continue;
+
+            if (isTreeAncestor(anc, p))
+                return true;
+
+            marks[p] = stamp;
+            stack.append(p);
+        }
+    }
+    return false;
+}
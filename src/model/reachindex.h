@@ -0,0 +1,51 @@
+#ifndef REACHINDEX_H
+#define REACHINDEX_H
+
+#include <QVector>
+#include "revgraph.h"
+
+//! Answers "is a row an ancestor of another one" without asking git
+/*!
+    Built once per loading from a snapshot of the graph links, rows must
+    be in topological order, i.e. parents after their children.
+
+    Each row has a generation number, one more than the highest of its
+    parents, and a [pre, post] interval of a depth first visit of the
+    tree made by first parents only. An ancestor is always on a later row
+    with a lower generation, so most negative answers are immediate, and
+    a row is surely an ancestor if its interval contains the other one,
+    so are the answers along first parents. Only the remaining queries
+    walk the graph, pruned by row and generation.
+
+    Vectors are implicitly shared, so an index is cheap to copy, but
+    queries must be done from one thread only.
+*/
+class ReachIndex
+{
+public:
+    ReachIndex() : stamp(0) {}
+    bool build(const RevGraph::Links& links);
+    void clear();
+    bool isEmpty() const { return gen.isEmpty(); }
+    int count() const { return gen.count(); }
+    int generation(int row) const { return gen.at(row); }
+    bool isAncestor(int anc, int row) const;
+
+private:
+    bool isTreeAncestor(int anc, int row) const;
+
+    RevGraph::Links links;
+    QVector<int> gen;
+    QVector<int> pre;
+    QVector<int> post;
+    mutable QVector<int> marks; // visited rows of a query, by stamp
+    mutable QVector<int> stack;
+    mutable int stamp;
+};
+
+inline bool ReachIndex::isTreeAncestor(int anc, int row) const
+{
+    return pre.at(anc) <= pre.at(row) && post.at(row) <= post.at(anc);
+}
+
+#endif // REACHINDEX_H
@@ -0,0 +1,161 @@
+#include "revgraph.h"
+#include "revision.h"
+
+RevGraph::RevGraph(const RevIndex& r) : revs(r)
+{
+    clear();
+}
+
+void RevGraph::clear()
+{
+    rowRevs.clear();
+    parentOfs.clear();
+    parentOfs.append(0);
+    parentRows.clear();
+    childOfs.clear();
+    childRows.clear();
+}
+
+void RevGraph::reserve(int rows)
+{
+    // most revisions have one parent
+    rowRevs.reserve(rows);
+    parentOfs.reserve(rows + 1);
+    parentRows.reserve(rows);
+}
+
+void RevGraph::append(const Revision* r)
+{
+    parentRows.insert(parentRows.count(), r->parentsCount(), UNRESOLVED);
+    parentOfs.append(parentRows.count());
+    rowRevs.append(r);
+}
+
+void RevGraph::remove(int from, int to)
+{
+    // rows in [from, to) are dropped and following ones moved up
+    to = qMin(to, count());
+    if (from >= to)
+        return;
+
+    const int cnt = to - from;
+    const int first = parentOfs.at(from);
+    const int parentsCnt = parentOfs.at(to) - first;
+
+    rowRevs.remove(from, cnt);
+    parentOfs.remove(from + 1, cnt);
+    parentRows.remove(first, parentsCnt);
+
+    for (int i = from + 1; i < parentOfs.count(); i++)
+        parentOfs[i] -= parentsCnt;
+
+    // removed rows could be loaded again in another place and moved
+    // rows have a new number, so resolve them again
+    for (int i = 0; i < parentRows.count(); i++)
+        if (parentRows.at(i) >= from)
+            parentRows[i] = UNRESOLVED;
+
+    childOfs.clear();
+    childRows.clear();
+}
+
+void RevGraph::spliceTail(int tailRow, int headCnt)
+{
+    // rows from 'tailRow' on are moved in front of the others and first
+    // 'headCnt' rows are dropped, already resolved parents are remapped
+    const int cnt = count();
+    const int tailCnt = cnt - tailRow;
+
+    QVector<const Revision*> newRevs;
+    QVector<int> newOfs;
+    QVector<int> newRows;
+    newRevs.reserve(cnt - headCnt);
+    newOfs.reserve(cnt - headCnt + 1);
+    newRows.reserve(parentRows.count());
+    newOfs.append(0);
+
+    for (int n = headCnt; n < cnt; n++) {
+
+        const int row = (n < headCnt + tailCnt ? tailRow + n - headCnt : n - tailCnt);
+        newRevs.append(rowRevs.at(row));
+
+        for (int i = parentOfs.at(row); i < parentOfs.at(row + 1); i++) {
+
+            int p = parentRows.at(i);
+            if (p >= tailRow)
+                p -= tailRow;
+            else if (p >= headCnt)
+                p += tailCnt - headCnt;
+            else
+                p = UNRESOLVED;
+
+            newRows.append(p);
+        }
+        newOfs.append(newRows.count());
+    }
+    rowRevs = newRevs;
+    parentOfs = newOfs;
+    parentRows = newRows;
+    childOfs.clear();
+    childRows.clear();
+}
+
+int RevGraph::resolve(int row, int n) const
+{
+    const Revision* r = revs.value(ObjectId(rowRevs.at(row)->parent(n)));
+    if (!r)
+        return -1; // not cached, could arrive later
+
+    parentRows[parentOfs.at(row) + n] = r->orderIdx;
+    return r->orderIdx;
+}
+
+void RevGraph::indexChilds()
+{
+    // count children of each row, then lay them out back to back
+    // in loading order, the same order in which they are visited
+    const int cnt = count();
+    childOfs.fill(0, cnt + 1);
+
+    for (int row = 0; row < cnt; row++)
+        for (int n = 0, pc = parentsCount(row); n < pc; n++) {
+            const int p = parent(row, n);
+            if (p != -1 && p < cnt)
+                childOfs[p + 1]++;
+        }
+
+    for (int row = 0; row < cnt; row++)
+        childOfs[row + 1] += childOfs.at(row);
+
+    QVector<int> fillPos(childOfs);
+    childRows.resize(childOfs.at(cnt));
+
+    for (int row = 0; row < cnt; row++)
+        for (int n = 0, pc = parentsCount(row); n < pc; n++) {
+            const int p = parent(row, n);
+            if (p != -1 && p < cnt)
+                childRows[fillPos[p]++] = row;
+        }
+}
+
+const RevGraph::Links RevGraph::links()
+{
+/*
+   Vectors are implicitly shared, so this is cheap, and any later
+   change to the graph detaches it from the returned copies.
+   Parents not in history are still unresolved and are set to -1.
+*/
+    if (childOfs.count() != count() + 1)
+        indexChilds();
+
+    Links l;
+    l.parentOfs = parentOfs;
+    l.childOfs = childOfs;
+    l.childRows = childRows;
+    l.parentRows.resize(parentRows.count());
+    for (int row = 0, cnt = count(); row < cnt; row++)
+        for (int i = parentOfs.at(row); i < parentOfs.at(row + 1); i++)
+            l.parentRows[i] = parent(row, i - parentOfs.at(row));
+
+    return l;
+}
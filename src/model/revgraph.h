@@ -0,0 +1,86 @@
+#ifndef REVGRAPH_H
+#define REVGRAPH_H
+
+#include <QVector>
+#include "revindex.h"
+
+class Revision;
+
+//! Commit graph of a history, by row
+/*!
+    A row is the position of a revision in the history order, the same
+    of Revision::orderIdx, and the graph links rows with plain integers,
+    so that walking the history is a scan of flat arrays instead of an
+    hash lookup of a text sha for each followed parent.
+
+    Parents of all rows are stored back to back in one shared array, row
+    'n' parents are in [parentOfs[n], parentOfs[n + 1]). Because parents
+    are received after their children, a parent row is resolved on first
+    access, from the parent sha in the revision record, and then cached,
+    so parent ids are never copied out of the loaded data.
+
+    Children are stored the same way, but are computed only on request,
+    with indexChilds(), once the whole history has been loaded.
+*/
+class RevGraph
+{
+public:
+    //! Row links frozen by links(), safe to be read from another thread
+    struct Links
+    {
+        int count() const { return parentOfs.count() - 1; }
+
+        QVector<int> parentOfs;
+        QVector<int> parentRows; // -1 if parent is not in history
+        QVector<int> childOfs;
+        QVector<int> childRows;
+    };
+
+    explicit RevGraph(const RevIndex& revs);
+    void clear();
+    void reserve(int rows);
+    void append(const Revision* r);
+    void remove(int from, int to);
+    void spliceTail(int tailRow, int headCnt);
+    void setRevision(int row, const Revision* r) { rowRevs[row] = r; }
+    int count() const { return rowRevs.count(); }
+    const Revision* revision(int row) const { return rowRevs.at(row); }
+    const QVector<const Revision*>& revisions() const { return rowRevs; }
+    int parentsCount(int row) const { return parentOfs.at(row + 1) - parentOfs.at(row); }
+    int parent(int row, int n) const;
+    void indexChilds();
+    const Links links();
+    int childsCount(int row) const;
+    int child(int row, int n) const { return childRows.at(childOfs.at(row) + n); }
+
+private:
+    enum { UNRESOLVED = -2 };
+
+    int resolve(int row, int n) const;
+
+    const RevIndex& revs;
+    QVector<const Revision*> rowRevs;
+    QVector<int> parentOfs;          // count() + 1 entries
+    mutable QVector<int> parentRows; // UNRESOLVED until first access
+    QVector<int> childOfs;           // empty until indexChilds()
+    QVector<int> childRows;
+};
+
+inline int RevGraph::parent(int row, int n) const
+{
+    // returns -1 if parent is not (yet) in history
+    const int i = parentOfs.at(row) + n;
+    const int p = parentRows.at(i);
+    return (p != UNRESOLVED ? p : resolve(row, n));
+}
+
+inline int RevGraph::childsCount(int row) const
+{
+    // rows appended after indexChilds() have no children yet
+    if (row + 1 >= childOfs.count())
+        return 0;
+
+    return childOfs.at(row + 1) - childOfs.at(row);
+}
+
+#endif // REVGRAPH_H
@@ -0,0 +1,104 @@
+#include "revindex.h"
+
+const quint32 RevIndex::EMPTY_IDX;
+const quint64 RevIndex::EMPTY_SLOT;
+
+void RevIndex::reserve(int size)
+{
+    ids.reserve(size);
+    revs.reserve(size);
+
+    // keep load factor under 50%, probes sequences stay short
+    int capacity = 16;
+    while (capacity < 2 * size)
+        capacity *= 2;
+
+    if (capacity > table.count())
+        rehash(capacity);
+}
+
+void RevIndex::clear()
+{
+    // keep table size, histories are reloaded often with similar size
+    table.fill(EMPTY_SLOT);
+    ids.clear();
+    revs.clear();
+}
+
+void RevIndex::rehash(int capacity)
+{
+    table.fill(EMPTY_SLOT, capacity);
+    mask = (uint)capacity - 1;
+
+    quint64* t = table.data();
+    for (int i = 0; i < ids.count(); i++) {
+        const quint64 h = ids.at(i).hash64();
+        uint pos = (uint)h & mask;
+        while ((quint32)t[pos] != EMPTY_IDX)
+            pos = (pos + 1) & mask;
+
+        t[pos] = makeSlot(h, i);
+    }
+}
+
+void RevIndex::insert(const ObjectId& id, const Revision* r)
+{
+    if (2 * (revs.count() + 1) > table.count())
+        rehash(table.isEmpty() ? 16 : 2 * table.count());
+
+    const quint64 h = id.hash64();
+    const int pos = findSlot(id, h);
+    const quint32 idx = (quint32)table.at(pos);
+
+    if (idx != EMPTY_IDX) { // overwrite old content, as QHash::insert()
+        revs[(int)idx] = r;
+        return;
+    }
+    table[pos] = makeSlot(h, revs.count());
+    ids.append(id);
+    revs.append(r);
+}
+
+void RevIndex::remove(const ObjectId& id)
+{
+    if (table.isEmpty())
+        return;
+
+    int pos = findSlot(id, id.hash64());
+    const quint32 idx = (quint32)table.at(pos);
+    if (idx == EMPTY_IDX)
+        return;
+
+    // backward shift deletion, no tombstones left behind
+    quint64* t = table.data();
+    uint hole = (uint)pos;
+    uint cur = hole;
+    while (true) {
+        cur = (cur + 1) & mask;
+        const quint64 s = t[cur];
+        if ((quint32)s == EMPTY_IDX)
+            break;
+
+        // entry can fill the hole only if its home is not in (hole, cur]
+        const uint home = (uint)ids.at((int)(quint32)s).hash64() & mask;
+        bool stay = (hole <= cur ? (hole < home && home <= cur)
+                                 : (hole < home || home <= cur));
+        if (!stay) {
+            t[hole] = s;
+            hole = cur;
+        }
+    }
+    t[hole] = EMPTY_SLOT;
+
+    // move last entry in the freed dense position
+    const int last = revs.count() - 1;
+    if ((int)idx != last) {
+        const ObjectId lastId = ids.at(last);
+        const quint64 h = lastId.hash64();
+        t[findSlot(lastId, h)] = makeSlot(h, (int)idx);
+        ids[(int)idx] = lastId;
+        revs[(int)idx] = revs.at(last);
+    }
+    ids.pop_back();
+    revs.pop_back();
+}
@@ -0,0 +1,97 @@
+#ifndef REVINDEX_H
+#define REVINDEX_H
+
+#include <QVector>
+#include "objectid.h"
+
+class Revision;
+
+//! Flat hash index of the revisions of a history
+/*!
+    Revisions are stored in insertion order in two dense arrays, ids and
+    revisions, and an open addressing table with linear probing maps an
+    id to its dense index.
+
+    Each table slot is a single 64 bit word, the upper half are hash bits
+    of the id and the lower half the dense index, so that a probe touches
+    only the table and most mismatches are rejected without reading the
+    id array.
+
+    Removal moves the last entry in the hole, so dense indices are stable
+    only while nothing is removed, that is always the case but when an
+    early output is replaced by the final one.
+*/
+class RevIndex
+{
+public:
+    typedef QVector<const Revision*>::const_iterator const_iterator;
+
+    RevIndex() : mask(0) {}
+    void reserve(int size);
+    void clear();
+    int count() const { return revs.count(); }
+    bool isEmpty() const { return revs.isEmpty(); }
+    int indexOf(const ObjectId& id) const;
+    bool contains(const ObjectId& id) const { return indexOf(id) != -1; }
+    const Revision* value(const ObjectId& id) const;
+    const Revision* operator[](const ObjectId& id) const { return value(id); }
+    const Revision* at(int idx) const { return revs.at(idx); }
+    const ObjectId& idAt(int idx) const { return ids.at(idx); }
+    void insert(const ObjectId& id, const Revision* r);
+    void remove(const ObjectId& id);
+
+    // iterates on revisions
+    const_iterator begin() const { return revs.begin(); }
+    const_iterator end() const { return revs.end(); }
+    const_iterator constBegin() const { return revs.constBegin(); }
+    const_iterator constEnd() const { return revs.constEnd(); }
+
+private:
+    static const quint32 EMPTY_IDX = 0xFFFFFFFF;
+    static const quint64 EMPTY_SLOT = Q_UINT64_C(0xFFFFFFFFFFFFFFFF);
+
+    static quint64 makeSlot(quint64 h, int idx) {
+        return (h & Q_UINT64_C(0xFFFFFFFF00000000)) | (quint32)idx;
+    }
+    int findSlot(const ObjectId& id, quint64 h) const;
+    void rehash(int capacity);
+
+    QVector<quint64> table; // power of two sized
+    QVector<ObjectId> ids;
+    QVector<const Revision*> revs;
+    uint mask;
+};
+
+inline int RevIndex::findSlot(const ObjectId& id, quint64 h) const
+{
+    // returns the slot with 'id' or the empty one where to insert it
+    const quint64* t = table.constData();
+    const quint32 tag = (quint32)(h >> 32);
+    uint pos = (uint)h & mask;
+
+    while (true) {
+        const quint64 s = t[pos];
+        const quint32 idx = (quint32)s;
+        if (idx == EMPTY_IDX || ((quint32)(s >> 32) == tag && ids.at((int)idx) == id))
+            return (int)pos;
+
+        pos = (pos + 1) & mask;
+    }
+}
+
+inline int RevIndex::indexOf(const ObjectId& id) const
+{
+    if (table.isEmpty())
+        return -1;
+
+    const quint32 idx = (quint32)table.at(findSlot(id, id.hash64()));
+    return (idx == EMPTY_IDX ? -1 : (int)idx);
+}
+
+inline const Revision* RevIndex::value(const ObjectId& id) const
+{
+    const int idx = indexOf(id);
+    return (idx != -1 ? revs.at(idx) : NULL);
+}
+
+#endif // REVINDEX_H
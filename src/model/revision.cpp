@@ -1,3 +1,4 @@
+#include <string.h>
 #include "revision.h"
 #include "common.h"
 
@@ -35,7 +36,28 @@ const QStringList Revision::parents() const
     return p;
 }
 
-int Revision::indexData(bool quick, bool withDiff) const {
+void Revision::appendRecord(QByteArray& out) const
+{
+/*
+  Appends this revision as a 'git log' record with log size, as
+  read from 'ba' after indexData(), so with shas already '\0'
+  terminated. Parsing it again gives back the same revision.
+
+  Diff content, if any, is not included.
+*/
+    setup();
+    const char* data = ba.constData();
+    int recStart = shaStart - 1; // boundary information
+    int logEnd = qMax(qMax(sLogStart + sLogLen, lLogStart + lLogLen), autDateStart + 10);
+
+    const char* end = static_cast<const char*>(memchr(data + logEnd, 0, ba.size() - logEnd));
+    int recEnd = (end ? int(end - data) : ba.size());
+
+    out.append("log size ").append(QByteArray::number(recEnd - recStart)).append('\n');
+    out.append(data + recStart, recEnd - recStart).append('\0');
+}
+
+int Revision::indexData(bool quick, bool withDiff, const DelimiterTable* dt) const {
 /*
   This is what 'git log' produces:
 
@@ -51,6 +73,9 @@ int Revision::indexData(bool quick, bool withDiff) const {
     - zero or more lines with log message
     - zero or more lines with diff content (only for file history)
     - a terminating '\0'
+
+  When 'dt' is given, delimiters are looked up there instead of
+  scanning the data again, see DelimiterTable.
 */
     const int last = ba.size() - 1;
     int logSize = 0, idx = start;
@@ -60,12 +85,16 @@ int Revision::indexData(bool quick, bool withDiff) const {
     const char* data = ba.constData();
     char* fixup = const_cast<char*>(data); // to build '\0' terminating strings
 
+    // data could be a shared mapping of a file, as example the history
+    // cache, where terminators are already saved, so write only when
+    // needed, otherwise each touched page would be written back to disk
+
     // FIXME: Magic numbers!
     if (start + 42 > last) // at least sha + 'X' + 'X' + '\n' + must be present
         return -1;
 
     if (data[start] == 'F') // "Final output", let caller handle this
-        return (ba.indexOf('\n', start) != -1 ? -2 : -1);
+        return (find('\n', start, dt) != -1 ? -2 : -1);
 
     // parse log size if present
     if (data[idx] == 'l') { // 'log size xxx\n'
@@ -89,7 +118,8 @@ int Revision::indexData(bool quick, bool withDiff) const {
 
     idx += 40; // now points to 'X' place holder
 
-    fixup[idx] = '\0'; // we want sha to be a '\0' terminated ascii string
+    if (data[idx] != '\0')
+        fixup[idx] = '\0'; // we want sha to be a '\0' terminated ascii string
 
     parentsCnt = 0;
 
@@ -102,7 +132,8 @@ int Revision::indexData(bool quick, bool withDiff) const {
         if (idx + 1 >= last)
             break;
 
-        fixup[idx] = '\0'; // we want parents '\0' terminated
+        if (data[idx] != '\0')
+            fixup[idx] = '\0'; // we want parents '\0' terminated
 
     } while (data[idx + 1] != '\n');
 
@@ -114,7 +145,7 @@ int Revision::indexData(bool quick, bool withDiff) const {
         revEnd = (logEnd > idx) ? logEnd - 1: idx;
         do { // search for "\n\0" to handle (rare) cases of '\0'
              // in content, see c42012 and bb8d8a6 in Linux tree
-            revEnd = ba.indexOf('\0', revEnd + 1);
+            revEnd = find('\0', revEnd + 1, dt);
             if (revEnd == -1)
                 return -1;
 
@@ -133,14 +164,14 @@ int Revision::indexData(bool quick, bool withDiff) const {
         return ++revEnd;
 
     comStart = ++idx;
-    idx = ba.indexOf('\n', idx); // committer line end
+    idx = find('\n', idx, dt); // committer line end
     if (idx == -1) {
         dbs("ASSERT in indexData: unexpected end of data");
         return -1;
     }
 
     autStart = ++idx;
-    idx = ba.indexOf('\n', idx); // author line end
+    idx = find('\n', idx, dt); // author line end
     if (idx == -1) {
         dbs("ASSERT in indexData: unexpected end of data");
         return -1;
@@ -150,7 +181,10 @@ int Revision::indexData(bool quick, bool withDiff) const {
 
     diffStart = diffLen = 0;
     if (withDiff) {
-        diffStart = logSize ? logEnd : ba.indexOf("\ndiff ", idx);
+        if (logSize)
+            diffStart = logEnd;
+        else
+            diffStart = (dt ? dt->indexOf(data, "\ndiff ", idx) : ba.indexOf("\ndiff ", idx));
 
         if (diffStart != -1 && diffStart < revEnd)
             diffLen = revEnd - ++diffStart;
@@ -168,7 +202,7 @@ int Revision::indexData(bool quick, bool withDiff) const {
         sLogStart = sLogLen = 0;
         lLogStart = lLogLen = 0;
     } else {
-        lLogStart = ba.indexOf('\n', sLogStart);
+        lLogStart = find('\n', sLogStart, dt);
         if (lLogStart != -1 && lLogStart < logEnd - 1) {
 
             sLogLen = lLogStart - sLogStart; // skip sLog trailing '\n'
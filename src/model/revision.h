@@ -7,7 +7,12 @@
 #include <QVector>
 #include <QStringList>
 #include "shastring.h"
-#include "lanes.h" // FIXME: model or view?
+#include "objectid.h"
+#include "delimitertable.h"
+#include "revindex.h"
+#include "lanestore.h" // FIXME: model or view?
+
+class RevisionArena;
 
 class Revision
 {
@@ -15,13 +20,19 @@ class Revision
     Revision();
     Revision(const Revision&);
     Revision& operator=(const Revision&);
+
+    // only in a RevisionArena, free with RevisionArena::destroy()
+    static void operator delete(void*);
 public:
-    Revision(const QByteArray& b, uint s, int idx, int* next, bool withDiff)
-        : orderIdx(idx), ba(b), start(s) {
+    static void* operator new(size_t, RevisionArena* arena);
+    static void operator delete(void* p, RevisionArena* arena);
+
+    Revision(const QByteArray& b, uint s, int idx, int* next, bool withDiff,
+             const DelimiterTable* dt = NULL) : orderIdx(idx), ba(b), start(s) {
 
         indexed = isDiffCache = isApplied = isUnApplied = false;
         descRefsMaster = ancRefsMaster = descBrnMaster = -1;
-        *next = indexData(true, withDiff);
+        *next = indexData(true, withDiff, dt);
     }
     bool isDiffCache; //
     bool isApplied;   //
@@ -37,9 +48,11 @@ public:
     const QString shortLog() const { setup(); return mid(sLogStart, sLogLen); }
     const QString longLog() const { setup(); return mid(lLogStart, lLogLen); }
     const QString diff() const { setup(); return mid(diffStart, diffLen); }
+    // could be called in advance, with the delimiters of 'ba' if available
+    inline void setup(const DelimiterTable* dt = NULL) const { if (!indexed) indexData(false, false, dt); }
+    void appendRecord(QByteArray& out) const;
 
-    QVector<LaneType> lanes;
-    QVector<int> childs;
+    PackedLanes lanes;
     QVector<int> descRefs;     // list of descendant refs index, normally tags
     QVector<int> ancRefs;      // list of ancestor refs index, normally tags
     QVector<int> descBranches; // list of descendant branches index
@@ -48,8 +61,10 @@ public:
     int descBrnMaster;  // by corresponding index xxxMaster
     int orderIdx;
 private:
-    inline void setup() const { if (!indexed) indexData(false, false); }
-    int indexData(bool quick, bool withDiff) const;
+    int indexData(bool quick, bool withDiff, const DelimiterTable* dt) const;
+    inline int find(char c, int from, const DelimiterTable* dt) const {
+        return (dt ? dt->indexOf(ba.constData(), c, from) : ba.indexOf(c, from));
+    }
     const QString mid(int start, int len) const;
     const QString midSha(int start, int len) const;
 
@@ -64,6 +79,6 @@ private:
 };
 
 // FIXME: include in class
-typedef QHash<ShaString, const Revision*> RevMap;  // faster then a map
+typedef RevIndex RevMap;
 
 #endif // REVISION_H
@@ -0,0 +1,55 @@
+#include "revisionarena.h"
+
+void RevisionArena::reserve(int cnt)
+{
+    // only the block list, blocks are still allocated when needed
+    QMutexLocker locker(&mutex);
+    blocks.reserve(blocks.count() + cnt / BLOCK_SIZE + 1);
+}
+
+void* RevisionArena::allocate()
+{
+    QMutexLocker locker(&mutex);
+
+    if (freeList) {
+        Slot* s = freeList;
+        freeList = s->next;
+        return s;
+    }
+    if (used == BLOCK_SIZE) {
+        blocks.append(new Slot[BLOCK_SIZE]);
+        used = 0;
+    }
+    return &blocks.last()[used++];
+}
+
+void RevisionArena::release(void* p)
+{
+    QMutexLocker locker(&mutex);
+
+    Slot* s = static_cast<Slot*>(p);
+    s->next = freeList;
+    freeList = s;
+}
+
+void RevisionArena::destroy(const Revision* r)
+{
+    if (!r)
+        return;
+
+    r->~Revision();
+    release(const_cast<Revision*>(r));
+}
+
+void RevisionArena::clear()
+{
+    // revisions still alive must be destructed by the caller
+    QMutexLocker locker(&mutex);
+
+    for (int i = 0; i < blocks.count(); i++)
+        delete[] blocks.at(i);
+
+    blocks.clear();
+    freeList = NULL;
+    used = BLOCK_SIZE;
+}
@@ -0,0 +1,62 @@
+#ifndef REVISIONARENA_H
+#define REVISIONARENA_H
+
+#include <QList>
+#include <QMutex>
+#include "revision.h"
+
+//! Storage of the revisions of a history
+/*!
+    Revisions are placed back to back in blocks of BLOCK_SIZE, so that
+    loading a big repository does not end up in millions of small heap
+    allocations, and all of them are given back at once with clear().
+
+    Revisions discarded while loading, as example filtered or duplicated
+    ones, are destroyed with destroy() and their slot is reused by the
+    next allocation.
+
+    Allocation is thread safe, revisions are created by the RevParser
+    thread while the GUI thread could discard some of them.
+*/
+class RevisionArena
+{
+public:
+    RevisionArena() : freeList(NULL), used(BLOCK_SIZE) {}
+    ~RevisionArena() { clear(); }
+    void reserve(int cnt);
+    void* allocate();
+    void release(void* p);
+    void destroy(const Revision* r);
+    void clear();
+
+private:
+    // prevent implicit C++ compiler defaults
+    RevisionArena(const RevisionArena&);
+    RevisionArena& operator=(const RevisionArena&);
+
+    enum { BLOCK_SIZE = 1024 };
+
+    union Slot {
+        Slot* next; // when in free list
+        char data[sizeof(Revision)];
+        quint64 align1;
+        void* align2;
+    };
+    QMutex mutex;
+    QList<Slot*> blocks;
+    Slot* freeList;
+    int used; // of the last block
+};
+
+inline void* Revision::operator new(size_t, RevisionArena* arena)
+{
+    return arena->allocate();
+}
+
+inline void Revision::operator delete(void* p, RevisionArena* arena)
+{
+    // called only if constructor throws
+    arena->release(p);
+}
+
+#endif // REVISIONARENA_H
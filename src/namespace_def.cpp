@@ -87,24 +87,6 @@ static void adjustPath(QStringList&, bool*) {}
 
 #endif // *********  end of platform dependent code ******
 
-// definition of an optimized sha hash function
-static inline uint hexVal(const uchar* ch) {
-
-    return (*ch < 64 ? *ch - 48 : *ch - 87);
-}
-
-uint qHash(const ShaString& s) { // fast path, called 6-7 times per revision
-
-    const uchar* ch = reinterpret_cast<const uchar*>(s.latin1());
-    return (hexVal(ch     ) << 24)
-         + (hexVal(ch +  2) << 20)
-         + (hexVal(ch +  4) << 16)
-         + (hexVal(ch +  6) << 12)
-         + (hexVal(ch +  8) <<  8)
-         + (hexVal(ch + 10) <<  4)
-         +  hexVal(ch + 12);
-}
-
 /* Value returned by this function should be used only as function argument,
  * and not stored in a variable because 'ba' value is overwritten at each
  * call so the returned ShaString could became stale very quickly
@@ -116,12 +98,6 @@ const ShaString QGit::toTempSha(const QString& sha) {
     return ShaString(sha.isEmpty() ? NULL : ba.constData());
 }
 
-const ShaString QGit::toPersistentSha(const QString& sha, QVector<QByteArray>& v) {
-
-    v.append(sha.toLatin1());
-    return ShaString(v.last().constData());
-}
-
 // minimum git version required
 const QString QGit::GIT_VERSION = "1.5.5";
 
@@ -158,11 +134,10 @@ const QString QGit::PATCHES_NAME = "qgit_import";
 
 // git index parameters
 const QString QGit::ZERO_SHA        = "0000000000000000000000000000000000000000";
-const QString QGit::CUSTOM_SHA      = "CUSTOM";
-const QString QGit::ALL_MERGE_FILES = "ALL_MERGE_FILES";
 
 const QByteArray QGit::ZERO_SHA_BA(QGit::ZERO_SHA.toLatin1());
 const ShaString  QGit::ZERO_SHA_RAW(QGit::ZERO_SHA_BA.constData());
+const ObjectId   QGit::ZERO_SHA_ID(QGit::ZERO_SHA_RAW);
 
 // settings keys
 const QString QGit::ORG_KEY         = "qgit";
@@ -202,6 +177,7 @@ const QString QGit::EXT_DIFF_DEF    = "kompare";
 // cache file
 const QString QGit::BAK_EXT          = ".bak";
 const QString QGit::C_DAT_FILE       = "/qgit_cache.dat";
+const QString QGit::H_DAT_FILE       = "/qgit_history.dat";
 
 // misc
 const QString QGit::QUOTE_CHAR = "$";
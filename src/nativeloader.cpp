@@ -0,0 +1,78 @@
+/*
+    Description: worker thread that reads main history from repository objects
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include "common.h"
+#include "nativeloader.h"
+
+NativeLoader::NativeLoader(QObject* p, const QString& gitDir, const QStringList& t, bool body)
+                          : QThread(p), log(gitDir), tips(t), withBody(body)
+{
+    revsCnt = 0;
+    state = WALKING;
+    canceling = false;
+}
+
+NativeLoader::~NativeLoader()
+{
+    cancel();
+    wait();
+    qDeleteAll(chunks);
+}
+
+void NativeLoader::cancel()
+{
+    // chunks not yet taken are thrown away
+    canceling = true;
+}
+
+NativeLoader::State NativeLoader::takeData(QList<QByteArray*>& data)
+{
+    QMutexLocker locker(&mutex);
+    data = chunks;
+    chunks.clear();
+    return state;
+}
+
+void NativeLoader::setState(State s)
+{
+    mutex.lock();
+    state = s;
+    mutex.unlock();
+    emit dataReady();
+}
+
+void NativeLoader::run()
+{
+    if (!log.walk(tips, withBody)) {
+        setState(FAILED);
+        return;
+    }
+    // read only by caller after the state change
+    revsCnt = log.count();
+    loadedHeads = log.heads();
+    setState(FORMATTING);
+
+    for (int row = 0, rows = FIRST_CHUNK_ROWS; row < revsCnt && !canceling; rows = CHUNK_ROWS) {
+
+        const int last = qMin(row + rows, revsCnt);
+        QByteArray* ba = new QByteArray();
+        ba->reserve((last - row) * 400); // a guess
+
+        if (!log.format(row, last, *ba)) {
+            delete ba;
+            setState(FAILED);
+            return;
+        }
+        row = last;
+
+        mutex.lock();
+        chunks.append(ba);
+        mutex.unlock();
+        emit dataReady();
+    }
+    if (!canceling)
+        setState(DONE);
+}
@@ -0,0 +1,61 @@
+#ifndef NATIVELOADER_H
+#define NATIVELOADER_H
+
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+
+#include "git/nativelog.h"
+
+class QByteArray;
+
+/*
+   Reads main history with a NativeLog in a worker thread, so that
+   GUI is not frozen while a big history is walked and formatted.
+
+   History is walked at once and then records are formatted in chunks,
+   each one is sent with dataReady() and collected by the caller with
+   takeData(), in order, so that first rows are loaded while the rest
+   is still to be read. Caller should fall back on 'git log' in case
+   of FAILED state, also when some chunk has been already taken.
+*/
+class NativeLoader : public QThread
+{
+    Q_OBJECT
+public:
+    enum State { WALKING, FORMATTING, DONE, FAILED };
+
+    NativeLoader(QObject* parent, const QString& gitDir, const QStringList& tips, bool withBody);
+    ~NativeLoader();
+    State takeData(QList<QByteArray*>& data); // caller takes ownership
+    int count() const { return revsCnt; }            // valid after WALKING
+    const QStringList heads() const { return loadedHeads; } // valid after WALKING
+    void cancel();
+
+signals:
+    void dataReady();
+
+protected:
+    virtual void run();
+
+private:
+    enum {
+        FIRST_CHUNK_ROWS = 500,  // to show something soon
+        CHUNK_ROWS = 20000
+    };
+    void setState(State s);
+
+    NativeLog log;
+    const QStringList tips;
+    const bool withBody;
+    int revsCnt;
+    QStringList loadedHeads;
+
+    QMutex mutex;
+    QList<QByteArray*> chunks; // formatted and not yet taken
+    State state;
+    volatile bool canceling; // polled without lock while formatting
+};
+
+#endif
@@ -0,0 +1,267 @@
+/*
+    Description: worker thread that parses 'git log' output
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include "common.h"
+#include "loadstats.h"
+#include "model/revisionarena.h"
+#include "revparser.h"
+
+RevParser::RevParser(QObject* p, RevisionArena* a, bool wd) : QThread(p), arena(a), withDiff(wd)
+{
+    halfChunk = NULL;
+    jobMapped = jobLast = hasJob = busy = resultReady = canceling = false;
+}
+
+RevParser::~RevParser()
+{
+    cancel();
+    wait();
+    freeResult(result);
+    delete halfChunk;
+}
+
+void RevParser::freeResult(Result& r)
+{
+    FOREACH (QVector<Revision*>, it, r.revs)
+        arena->destroy(*it); // NULL entries are fine
+
+    qDeleteAll(r.buffers);
+    r = Result();
+}
+
+void RevParser::parse(const QList<QByteArray*>& buffers, bool isMapped, bool isLast)
+{
+    QMutexLocker locker(&mutex);
+
+    if (busy || canceling) {
+        dbs("ASSERT in RevParser::parse(), called while busy");
+        return;
+    }
+    jobBuffers = buffers;
+    jobMapped = isMapped;
+    jobLast = isLast;
+    hasJob = busy = true;
+
+    if (!isRunning())
+        start();
+    else
+        jobReady.wakeOne();
+}
+
+bool RevParser::takeResult(Result& r)
+{
+    QMutexLocker locker(&mutex);
+
+    if (!resultReady)
+        return false;
+
+    r = result;
+    result = Result();
+    resultReady = busy = false;
+    return true;
+}
+
+void RevParser::discardResult()
+{
+    // free a result that will not be taken, to be
+    // called when parsing is canceled, after wait()
+    QMutexLocker locker(&mutex);
+    freeResult(result);
+    resultReady = busy = false;
+}
+
+bool RevParser::isBusy() const
+{
+    QMutexLocker locker(&mutex);
+    return busy;
+}
+
+void RevParser::cancel()
+{
+    // caller should wait() for the thread to finish before
+    // freeing any buffer passed to parse()
+    QMutexLocker locker(&mutex);
+    canceling = true;
+    jobReady.wakeOne();
+}
+
+void RevParser::run()
+{
+    forever {
+        QList<QByteArray*> buffers;
+        bool isMapped, isLast;
+
+        mutex.lock();
+        while (!hasJob && !canceling)
+            jobReady.wait(&mutex);
+
+        if (canceling) {
+            mutex.unlock();
+            return;
+        }
+        buffers = jobBuffers;
+        isMapped = jobMapped;
+        isLast = jobLast;
+        hasJob = false;
+        jobBuffers.clear();
+        mutex.unlock();
+
+        Result r;
+        const qint64 startTime = LoadStats::now();
+        if (isMapped) {
+            const QByteArray& ba = *buffers.first();
+            r.consumed = parseMappedBuffer(ba, r);
+
+            if (isLast && r.consumed < ba.size() && !canceling) {
+                // last record is not '\0' terminated, so this
+                // is the only deep copy involved in the whole loading
+                QByteArray* tail = new QByteArray(ba.constData() + r.consumed,
+                                                  ba.size() - r.consumed);
+                tail->append('\0');
+                r.buffers.append(tail);
+                addSplittedChunks(tail, r);
+            }
+        } else
+            FOREACH (QList<QByteArray*>, it, buffers)
+                parseSingleBuffer(**it, r);
+
+        if (canceling) {
+            freeResult(r);
+            return;
+        }
+        r.parseTime = LoadStats::now() - startTime;
+        mutex.lock();
+        result = r;
+        resultReady = true;
+        mutex.unlock();
+
+        emit parsed(); // queued to GUI thread
+
+        if (isLast)
+            return;
+    }
+}
+
+int RevParser::parseChunk(const QByteArray& ba, int ofs, const DelimiterTable& dt, Result& r)
+{
+    int nextOfs;
+    Revision* rev;
+
+    do {
+        // only here we create a new rev, order index is
+        // set upon insertion, see Git::addRevision()
+        rev = new (arena) Revision(ba, ofs, -1, &nextOfs, withDiff, &dt);
+
+        if (nextOfs == -2) {
+            arena->destroy(rev);
+            r.revs.append(NULL);
+            ofs = dt.indexOf(ba.constData(), '\n', ofs) + 1;
+        }
+    } while (nextOfs == -2);
+
+    if (nextOfs == -1) { // half chunk detected
+        arena->destroy(rev);
+        return -1;
+    }
+    rev->setup(&dt); // index also the log here, not later in GUI thread
+    r.revs.append(rev);
+    return nextOfs;
+}
+
+void RevParser::parseSingleBuffer(const QByteArray& ba, Result& r)
+{
+    if (ba.size() == 0 || canceling)
+        return;
+
+    int ofs = 0, newOfs, bz = ba.size();
+
+    /* Due to unknown reasons randomly first byte
+     * of 'ba' is 0, this seems to happen only when
+     * using QFile::read(), i.e. with temporary file
+     * interface. Until we discover the real reason
+     * workaround this skipping the bogus byte
+     */
+    if (ba.at(0) == 0 && bz > 1 && !halfChunk)
+        ofs++;
+
+    // one pass over the whole buffer to find all delimiters
+    delims.scan(ba.constData(), bz);
+
+    while (bz - ofs > 0 && !canceling) {
+
+        if (!halfChunk) {
+
+            newOfs = parseChunk(ba, ofs, delims, r);
+            if (newOfs == -1)
+                break; // half chunk detected
+
+            ofs = newOfs;
+
+        } else { // less then 1% of cases with READ_BLOCK_SIZE = 64KB
+
+            int end = delims.indexOf(ba.constData(), '\0', 0);
+            if (end == -1) // consecutives half chunks
+                break;
+
+            ofs = end + 1;
+            baAppend(&halfChunk, ba.constData(), ofs);
+            r.buffers.append(halfChunk);
+            addSplittedChunks(halfChunk, r);
+            halfChunk = NULL;
+        }
+    }
+    // save any remaining half chunk
+    if (bz - ofs > 0)
+        baAppend(&halfChunk, ba.constData() + ofs,  bz - ofs);
+}
+
+int RevParser::parseMappedBuffer(const QByteArray& ba, Result& r)
+{
+    int ofs = 0, newOfs, bz = ba.size();
+
+    // a record never starts with '\0', see parseSingleBuffer()
+    if (ba.at(0) == 0 && bz > 1)
+        ofs++;
+
+    delims.scan(ba.constData(), bz);
+
+    while (bz - ofs > 0 && !canceling) {
+
+        newOfs = parseChunk(ba, ofs, delims, r);
+        if (newOfs == -1)
+            break; // half chunk, will be mapped again at next round
+
+        ofs = newOfs;
+    }
+    return ofs;
+}
+
+void RevParser::addSplittedChunks(const QByteArray* hc, Result& r)
+{
+    if (hc->at(hc->size() - 1) != 0) {
+        dbs("ASSERT in RevParser, bad half chunk");
+        return;
+    }
+    // could be called while parsing another buffer, so
+    // do not overwrite the delimiters of that one
+    DelimiterTable dt;
+    dt.scan(hc->constData(), hc->size());
+
+    // do not assume we have only one chunk in hc
+    int ofs = 0;
+    while (ofs != -1 && ofs != (int)hc->size())
+        ofs = parseChunk(*hc, ofs, dt, r);
+}
+
+void RevParser::baAppend(QByteArray** baPtr, const char* ascii, int len)
+{
+    if (*baPtr)
+        // we cannot use QByteArray::append(const char*)
+        // because 'ascii' is not '\0' terminating
+        (*baPtr)->append(QByteArray::fromRawData(ascii, len));
+    else
+        *baPtr = new QByteArray(ascii, len);
+}
@@ -0,0 +1,76 @@
+#ifndef REVPARSER_H
+#define REVPARSER_H
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "model/delimitertable.h"
+
+class QByteArray;
+class Revision;
+class RevisionArena;
+
+/*
+   Splits 'git log' output in records and builds fully indexed
+   revisions in a worker thread, so that GUI thread is left only
+   with the insertion of the new revisions in the history.
+
+   One job at a time is accepted, the caller waits for parsed()
+   signal and then collects the result with takeResult().
+*/
+class RevParser : public QThread
+{
+    Q_OBJECT
+public:
+    struct Result
+    {
+        Result() : consumed(0), parseTime(0) {}
+
+        QVector<Revision*> revs;    // a NULL entry marks a new early output
+        QList<QByteArray*> buffers; // new buffers pointed by revs, if any
+        int consumed;               // parsed bytes of a mapped buffer
+        qint64 parseTime;           // usecs, see LoadStats
+    };
+
+    RevParser(QObject* parent, RevisionArena* arena, bool withDiff);
+    ~RevParser();
+    void parse(const QList<QByteArray*>& buffers, bool isMapped, bool isLast);
+    bool takeResult(Result& r);
+    void discardResult();
+    bool isBusy() const;
+    void cancel();
+
+signals:
+    void parsed();
+
+protected:
+    virtual void run();
+
+private:
+    int parseChunk(const QByteArray& ba, int ofs, const DelimiterTable& dt, Result& r);
+    void parseSingleBuffer(const QByteArray& ba, Result& r);
+    int parseMappedBuffer(const QByteArray& ba, Result& r);
+    void addSplittedChunks(const QByteArray* hc, Result& r);
+    void baAppend(QByteArray** src, const char* ascii, int len);
+    void freeResult(Result& r);
+
+    mutable QMutex mutex;
+    QWaitCondition jobReady;
+    QList<QByteArray*> jobBuffers;
+    DelimiterTable delims; // of the buffer being parsed
+    Result result;
+    RevisionArena* arena; // where revisions are created
+    QByteArray* halfChunk;
+    const bool withDiff;
+    bool jobMapped;
+    bool jobLast;
+    bool hasJob;
+    bool busy;
+    bool resultReady;
+    volatile bool canceling; // polled without lock while parsing
+};
+
+#endif
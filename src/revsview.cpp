@@ -39,8 +39,8 @@ RevsView::RevsView(MainImpl* mi, Git* g, bool isMain) : Domain(mi, g, isMain) {
     connect(m(), SIGNAL(typeWriterFontChanged()),
             tab()->textEditDiff, SLOT(typeWriterFontChanged()));
 
-    connect(git, SIGNAL(newRevsAdded(const FileHistory*, const QVector<ShaString>&)),
-            this, SLOT(on_newRevsAdded(const FileHistory*, const QVector<ShaString>&)));
+    connect(git, SIGNAL(newRevsAdded(const FileHistory*, const QVector<ObjectId>&)),
+            this, SLOT(on_newRevsAdded(const FileHistory*, const QVector<ObjectId>&)));
 
     connect(git, SIGNAL(loadCompleted(const FileHistory*, const QString&)),
             this, SLOT(on_loadCompleted(const FileHistory*, const QString&)));
@@ -142,7 +142,7 @@ void RevsView::viewPatch(bool newTab) {
     UPDATE_DM_MASTER(pv, false);
 }
 
-void RevsView::on_newRevsAdded(const FileHistory* fh, const QVector<ShaString>&) {
+void RevsView::on_newRevsAdded(const FileHistory* fh, const QVector<ObjectId>&) {
 
     if (!git->isMainHistory(fh) || !st.sha().isEmpty())
         return;
@@ -29,7 +29,7 @@ public:
     Ui_TabRev* tab() { return revTab; }
 
 private slots:
-    void on_newRevsAdded(const FileHistory*, const QVector<ShaString>&);
+    void on_newRevsAdded(const FileHistory*, const QVector<ObjectId>&);
     void on_loadCompleted(const FileHistory*, const QString& stats);
     void on_lanesContextMenuRequested(const QStringList&, const QStringList&);
     void on_updateRevDesc();
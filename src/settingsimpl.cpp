@@ -50,6 +50,9 @@ SettingsImpl::SettingsImpl(QWidget* p, Git* g, int defTab) : QDialog(p), git(g)
     checkBoxCommitUseDefMsg->setChecked(f & USE_CMT_MSG_F);
     checkBoxRangeSelectDialog->setChecked(f & RANGE_SELECT_F);
     checkBoxReopenLastRepo->setChecked(f & REOPEN_REPO_F);
+    checkBoxLogOnDemand->setChecked(f & LOG_ON_DEMAND_F);
+    checkBoxCompactLanes->setChecked(f & COMPACT_LANES_F);
+    checkBoxParallelLog->setChecked(f & PARALLEL_LOG_F);
     checkBoxRelativeDate->setChecked(f & REL_DATE_F);
     checkBoxLogDiffTab->setChecked(f & LOG_DIFF_TAB_F);
     checkBoxSmartLabels->setChecked(f & SMART_LBL_F);
@@ -278,6 +281,21 @@ void SettingsImpl::checkBoxReopenLastRepo_toggled(bool b) {
     changeFlag(REOPEN_REPO_F, b);
 }
 
+void SettingsImpl::checkBoxLogOnDemand_toggled(bool b) {
+
+    changeFlag(LOG_ON_DEMAND_F, b);
+}
+
+void SettingsImpl::checkBoxCompactLanes_toggled(bool b) {
+
+    changeFlag(COMPACT_LANES_F, b);
+}
+
+void SettingsImpl::checkBoxParallelLog_toggled(bool b) {
+
+    changeFlag(PARALLEL_LOG_F, b);
+}
+
 void SettingsImpl::checkBoxRelativeDate_toggled(bool b) {
 
     changeFlag(REL_DATE_F, b);
@@ -27,6 +27,9 @@ protected slots:
     void checkBoxSign_toggled(bool b);
     void checkBoxRangeSelectDialog_toggled(bool b);
     void checkBoxReopenLastRepo_toggled(bool b);
+    void checkBoxLogOnDemand_toggled(bool b);
+    void checkBoxCompactLanes_toggled(bool b);
+    void checkBoxParallelLog_toggled(bool b);
     void checkBoxRelativeDate_toggled(bool b);
     void checkBoxLogDiffTab_toggled(bool b);
     void checkBoxSmartLabels_toggled(bool b);
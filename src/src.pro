@@ -40,6 +40,11 @@ unix {
     TARGET = qgit
     target.path = ~/bin
     CONFIG += x11
+
+    # git objects are read directly, see USE_NATIVE_LOG in git/nativelog.h
+    HEADERS += nativeloader.h
+    SOURCES += nativeloader.cpp git/objectstore.cpp git/nativelog.cpp
+    LIBS += -lz
 }
 
 macx {
@@ -76,7 +81,7 @@ FORMS += commit.ui console.ui customaction.ui fileview.ui help.ui \
 
 HEADERS += annotate.h cache.h commitimpl.h common.h config.h consoleimpl.h \
            customactionimpl.h dataloader.h domain.h exceptionmanager.h \
-           filecontent.h filelist.h fileview.h git.h help.h lanes.h \
+           filecontent.h filelist.h fileview.h git.h help.h historycache.h lanebuilder.h lanes.h \
            listview.h mainimpl.h myprocess.h patchcontent.h patchview.h \
             revdesc.h revsview.h settingsimpl.h \
            treeview.h \
@@ -94,25 +99,40 @@ HEADERS += annotate.h cache.h commitimpl.h common.h config.h consoleimpl.h \
     patchcontentfindsupport.h \
     patchtextblockuserdata.h \
     filehistory.h \
+    loadstats.h \
     listviewproxy.h \
     listviewdelegate.h \
+    revparser.h \
+    treeindexer.h \
     ui/rangeselectimpl.h \
     ui/customtabwidget.h \
     ui/customtab.h \
     model/shastring.h \
+    model/objectid.h \
     model/revision.h \
+    model/revindex.h \
+    model/revgraph.h \
+    model/lanestore.h \
+    model/reachindex.h \
+    model/revisionarena.h \
+    model/delimitertable.h \
     model/reference.h \
     model/referencelist.h \
     model/tagreference.h \
     model/stgitpatchreference.h \
     git/references.h \
-    git/rungit_interface.h
+    git/rungit_interface.h \
+    git/objectstore.h \
+    git/commitgraph.h \
+    git/nativelog.h \
+    git/catfilebatch.h \
+    git/shardedlog.h
 
 
 SOURCES += annotate.cpp cache.cpp commitimpl.cpp consoleimpl.cpp \
            customactionimpl.cpp dataloader.cpp domain.cpp exceptionmanager.cpp \
-           filecontent.cpp filelist.cpp fileview.cpp git.cpp \
-           lanes.cpp listview.cpp mainimpl.cpp myprocess.cpp namespace_def.cpp \
+           filecontent.cpp filelist.cpp fileview.cpp git.cpp historycache.cpp \
+           lanebuilder.cpp lanes.cpp listview.cpp mainimpl.cpp myprocess.cpp namespace_def.cpp \
            patchcontent.cpp patchview.cpp  \
            revdesc.cpp revsview.cpp settingsimpl.cpp treeview.cpp \
     branchestree.cpp \
@@ -130,18 +150,31 @@ SOURCES += annotate.cpp cache.cpp commitimpl.cpp consoleimpl.cpp \
     patchcontentfindsupport.cpp \
     patchtextblockuserdata.cpp \
     filehistory.cpp \
+    loadstats.cpp \
     listviewproxy.cpp \
     listviewdelegate.cpp \
+    revparser.cpp \
+    treeindexer.cpp \
     ui/rangeselectimpl.cpp \
     ui/customtabwidget.cpp \
     ui/customtab.cpp \
     model/shastring.cpp \
+    model/objectid.cpp \
     model/revision.cpp \
+    model/revindex.cpp \
+    model/revgraph.cpp \
+    model/lanestore.cpp \
+    model/reachindex.cpp \
+    model/revisionarena.cpp \
+    model/delimitertable.cpp \
     model/reference.cpp \
     model/referencelist.cpp \
     model/tagreference.cpp \
     model/stgitpatchreference.cpp \
-    git/references.cpp
+    git/references.cpp \
+    git/commitgraph.cpp \
+    git/catfilebatch.cpp \
+    git/shardedlog.cpp
 
 DISTFILES += app_icon.rc helpgen.sh resources/* Src.vcproj todo.txt
 DISTFILES += ../COPYING ../exception_manager.txt ../README ../README_WIN.txt
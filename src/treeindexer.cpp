@@ -0,0 +1,215 @@
+/*
+    Description: worker thread that indexes refs of main history
+
+    Copyright: See COPYING file that comes with this distribution
+
+*/
+#include "common.h"
+#include "loadstats.h"
+#include "treeindexer.h"
+
+TreeIndexer::TreeIndexer(QObject* p, const RevGraph::Links& l, const QVector<uchar>& rt)
+                        : QThread(p), links(l), refTypes(rt)
+{
+    canceling = false;
+}
+
+TreeIndexer::~TreeIndexer()
+{
+    cancel();
+    wait();
+}
+
+void TreeIndexer::cancel()
+{
+    // result is thrown away, finished() is still sent
+    canceling = true;
+}
+
+void TreeIndexer::run()
+{
+    const qint64 startTime = LoadStats::now();
+    const int cnt = links.count();
+
+    res.descRefsMaster.fill(-1, cnt);
+    res.ancRefsMaster.fill(-1, cnt);
+    res.descBrnMaster.fill(-1, cnt);
+    tagOfRow.fill(-1, cnt);
+
+    indexDescendants();
+    indexAncestors();
+
+    if (!canceling && !res.reach.build(links))
+        dbs("Rows not in topological order, reachability index not built");
+
+    tagOfRow.clear();
+    tagDescs.clear();
+    res.indexTime = LoadStats::now() - startTime;
+}
+
+void TreeIndexer::indexDescendants()
+{
+    // walk down the tree from latest to oldest,
+    // compute nearest descendants
+    for (int i = 0, cnt = links.count(); i < cnt && !canceling; i++) {
+
+        const bool isB = (refTypes.at(i) & BRANCH);
+        const bool isT = (refTypes.at(i) & TAG);
+
+        if (isB) {
+            QVector<int> v;
+            if (res.descBrnMaster.at(i) != -1)
+                v = res.descBranches.value(res.descBrnMaster.at(i));
+            v.append(i);
+            res.descBranches.insert(i, v);
+        }
+        if (isT) {
+            addTag(i);
+            res.descRefs.insert(i, QVector<int>() << i);
+        }
+        for (int y = links.parentOfs.at(i); y < links.parentOfs.at(i + 1); y++) {
+
+            const int p = links.parentRows.at(y);
+            if (p == -1)
+                continue;
+
+            if (res.descBrnMaster.at(p) == -1)
+                res.descBrnMaster[p] = isB ? i : res.descBrnMaster.at(i);
+            else
+                mergeBranches(p, i);
+
+            if (res.descRefsMaster.at(p) == -1)
+                res.descRefsMaster[p] = isT ? i : res.descRefsMaster.at(i);
+            else
+                mergeNearTags(true, p, i);
+        }
+    }
+}
+
+void TreeIndexer::indexAncestors()
+{
+    // walk backward through the tree and compute nearest tagged ancestors
+    for (int i = links.count() - 1; i >= 0 && !canceling; i--) {
+
+        const bool isT = (refTypes.at(i) & TAG);
+        if (isT)
+            res.ancRefs.insert(i, QVector<int>() << i);
+
+        for (int y = links.childOfs.at(i); y < links.childOfs.at(i + 1); y++) {
+
+            const int c = links.childRows.at(y);
+            if (res.ancRefsMaster.at(c) == -1)
+                res.ancRefsMaster[c] = isT ? i : res.ancRefsMaster.at(i);
+            else
+                mergeNearTags(false, c, i);
+        }
+    }
+}
+
+void TreeIndexer::addTag(int row)
+{
+    // descendants of a tag are the ones of its nearest descendant tags,
+    // already known because they are on lower rows
+    const int t = tagDescs.count();
+    QBitArray descs(t + 1);
+
+    const int master = res.descRefsMaster.at(row);
+    if (master != -1) {
+
+        const QVector<int> nr(res.descRefs.value(master));
+        for (int i = 0; i < nr.count(); i++) {
+
+            const int n = tagOfRow.at(nr[i]);
+            if (n == -1) {
+                dbp("ASSERT descendant for row %1 not found", row);
+                break;
+            }
+            descs |= tagDescs.at(n); // shorter one is padded with zeros
+        }
+    }
+    descs.setBit(t);
+    tagOfRow[row] = t;
+    tagDescs.append(descs);
+}
+
+TreeIndexer::TagRelation TreeIndexer::tagRelation(int row1, int row2) const
+{
+    // relation of tag on 'row1' with respect to tag on 'row2'
+    const int t1 = tagOfRow.at(row1);
+    const int t2 = tagOfRow.at(row2);
+
+    if (t1 > t2 && tagDescs.at(t1).testBit(t2))
+        return ANCESTOR;
+
+    if (t2 > t1 && tagDescs.at(t2).testBit(t1))
+        return DESCENDANT;
+
+    return UNRELATED;
+}
+
+void TreeIndexer::mergeBranches(int p, int r)
+{
+    const int r_descBrnMaster = (refTypes.at(r) & BRANCH ? r : res.descBrnMaster.at(r));
+
+    if (res.descBrnMaster.at(p) == r_descBrnMaster || r_descBrnMaster == -1)
+        return;
+
+    // we want all the descendant branches, so just avoid duplicates
+    const QVector<int> src1(res.descBranches.value(res.descBrnMaster.at(p)));
+    const QVector<int> src2(res.descBranches.value(r_descBrnMaster));
+    QVector<int> dst(src1);
+    for (int i = 0; i < src2.count(); i++)
+        if (qFind(src1.constBegin(), src1.constEnd(), src2[i]) == src1.constEnd())
+            dst.append(src2[i]);
+
+    res.descBranches.insert(p, dst);
+    res.descBrnMaster[p] = p;
+}
+
+void TreeIndexer::mergeNearTags(bool down, int p, int r)
+{
+    const bool isTag = (refTypes.at(r) & TAG);
+    QVector<int>& masters = (down ? res.descRefsMaster : res.ancRefsMaster);
+    QHash<int, QVector<int> >& nearRefs = (down ? res.descRefs : res.ancRefs);
+    const int r_master = isTag ? r : masters.at(r);
+
+    if (masters.at(p) == r_master || r_master == -1)
+        return;
+
+    // we want the nearest tag only, so remove any tag
+    // that is ancestor of any other tag in p U r
+    const QVector<int> src1(nearRefs.value(masters.at(p)));
+    const QVector<int> src2(nearRefs.value(r_master));
+    QVector<int> dst(src1);
+
+    for (int s2 = 0; s2 < src2.count(); s2++) {
+
+        bool add = false;
+        for (int s1 = 0; s1 < src1.count(); s1++) {
+
+            if (src2[s2] == src1[s1]) {
+                add = false;
+                break;
+            }
+            const TagRelation rel = tagRelation(src2[s2], src1[s1]);
+            if (rel == UNRELATED) {
+                add = true; // could be an independent path
+                continue;
+            }
+            add = (down ? rel == ANCESTOR : rel == DESCENDANT);
+            if (add)
+                dst[s1] = -1; // mark for removing
+            else
+                break;
+        }
+        if (add)
+            dst.append(src2[s2]);
+    }
+    QVector<int> refs;
+    for (int s2 = 0; s2 < dst.count(); s2++)
+        if (dst[s2] != -1)
+            refs.append(dst[s2]);
+
+    nearRefs.insert(p, refs);
+    masters[p] = p;
+}
@@ -0,0 +1,77 @@
+#ifndef TREEINDEXER_H
+#define TREEINDEXER_H
+
+#include <QBitArray>
+#include <QHash>
+#include <QThread>
+#include <QVector>
+
+#include "model/reachindex.h"
+#include "model/revgraph.h"
+
+/*
+   Computes nearest tags and descendant branches of each row of the main
+   history, and the reachability index of its rows, in a worker thread, so
+   that GUI is not frozen after loading of big repositories.
+
+   Input is a snapshot of the graph and of the refs of each row, taken by
+   the caller in GUI thread, output is kept aside and copied by the caller
+   in the revisions only when finished() is received and isCanceled() is
+   false, so that a view never sees half indexed data.
+*/
+class TreeIndexer : public QThread
+{
+    Q_OBJECT
+public:
+    enum RefType {
+        BRANCH = 1, // local or remote
+        TAG    = 2
+    };
+
+    struct Result
+    {
+        Result() : indexTime(0) {}
+
+        QVector<int> descRefsMaster; // by row, see Revision
+        QVector<int> ancRefsMaster;
+        QVector<int> descBrnMaster;
+        QHash<int, QVector<int> > descRefs; // only rows that own a list
+        QHash<int, QVector<int> > ancRefs;
+        QHash<int, QVector<int> > descBranches;
+        ReachIndex reach; // empty if rows are not in topological order
+        qint64 indexTime; // usecs, see LoadStats
+    };
+
+    TreeIndexer(QObject* parent, const RevGraph::Links& links, const QVector<uchar>& refTypes);
+    ~TreeIndexer();
+    void cancel();
+    bool isCanceled() const { return canceling; }
+    const Result& result() const { return res; } // valid once finished
+
+protected:
+    virtual void run();
+
+private:
+    enum TagRelation { UNRELATED, ANCESTOR, DESCENDANT };
+
+    void indexDescendants();
+    void indexAncestors();
+    void addTag(int row);
+    TagRelation tagRelation(int row1, int row2) const;
+    void mergeBranches(int p, int r);
+    void mergeNearTags(bool down, int p, int r);
+
+    const RevGraph::Links links;
+    const QVector<uchar> refTypes;
+    Result res;
+
+    // tags are numbered in row order, so descendants of a tag have a
+    // lower number and bit 'n' of tagDescs[t] tells if tag 'n' is a
+    // descendant of tag 't', or is 't' itself. Only t + 1 bits are
+    // stored, 20k tags take about 25MB
+    QVector<int> tagOfRow; // -1 if row is not tagged
+    QVector<QBitArray> tagDescs;
+    volatile bool canceling; // polled without lock while indexing
+};
+
+#endif